@@ -62,7 +62,7 @@ function drawChart(data, type) {
             .domain([-1, 1])
             .range([height, 0]);
     }
-    else if (type == "Moran") {
+    else if (type == "Moran" || type == "Wilcoxon") { // z-scores
         
         var minY = d3.min(data, function (d) { return d.Value; });
         var maxY = d3.max(data, function (d) { return d.Value; });
@@ -140,7 +140,7 @@ function drawChart(data, type) {
         d3.selectAll(".geneNameText").remove();// remove text from highlightBars()
         tooltip
             .style("opacity", 1)
-            .text(d.Gene)
+            .text(d.PValue !== undefined ? d.Gene + " (p = " + d.PValue.toPrecision(2) + ")" : d.Gene)
             .attr("x", x(d.Gene) + x.bandwidth() / 2)
             .attr("y", d.Value > 0 ? y(d.Value) - 20 : y(d.Value) + 20)
             .attr("fill", "black");
@@ -9,9 +9,15 @@ CorrelationModeAction::CorrelationModeAction(QObject* parent, const QString& tit
     VerticalGroupAction(parent, title),
     _geneSurferPlugin(dynamic_cast<GeneSurferPlugin*>(parent->parent())),
     _diffAction(this, "Filter by diff"),
+    _wilcoxonAction(this, "Filter by Wilcoxon rank-sum"),
     _moranAction(this, "Filter by Moran's I"),
     _spatialCorrelationZAction(this, "Filter by Spatial Correlation Z"),
-    _spatialCorrelationYAction(this, "Filter by Spatial Correlation Y")
+    _spatialCorrelationYAction(this, "Filter by Spatial Correlation Y"),
+    _moranWeightsAction(this, "Moran weights"),
+    _moranNeighborsAction(this, "Moran neighbours", 1, 50, 8),
+    _moranRadiusAction(this, "Moran radius", 1, 10, 2),
+    _moranPermutationAction(this, "Moran permutation test", false),
+    _moranPermutationsAction(this, "Moran permutations", 99, 9999, 999)
 {
     setIcon(mv::util::StyledIcon("filter"));
     setToolTip("Gene filtering Mode");
@@ -19,14 +25,32 @@ CorrelationModeAction::CorrelationModeAction(QObject* parent, const QString& tit
     setLabelSizingType(LabelSizingType::Auto);
 
     addAction(&_diffAction);
+    addAction(&_wilcoxonAction);
     addAction(&_moranAction);
     addAction(&_spatialCorrelationZAction);
     addAction(&_spatialCorrelationYAction);
 
+    // order matches SpatialWeightType
+    _moranWeightsAction.initialize(QStringList({ "All pairs", "Nearest neighbours", "Radius" }), "All pairs");
+    addAction(&_moranWeightsAction);
+    addAction(&_moranNeighborsAction);
+    addAction(&_moranRadiusAction);
+    addAction(&_moranPermutationAction);
+    addAction(&_moranPermutationsAction);
+
     _diffAction.setToolTip("Diff mode");
+    _wilcoxonAction.setToolTip("Wilcoxon rank-sum test of the selection against all other points, as z-scores");
     _moranAction.setToolTip("Moran's I mode");
     _spatialCorrelationZAction.setToolTip("Spatial correlation mode Z");
     _spatialCorrelationYAction.setToolTip("Spatial correlation mode Y");
+    _moranWeightsAction.setToolTip("Neighbours weighted by Moran's I, all pairs needs memory and time quadratic in the number of flooded points, nearest neighbours and radius scale to large floods but give different scores");
+    _moranNeighborsAction.setToolTip("Number of nearest neighbours weighted by Moran's I");
+    _moranNeighborsAction.setEnabled(false);
+    _moranRadiusAction.setToolTip("Radius of the neighbours weighted by Moran's I, in mean nearest-neighbour distances");
+    _moranRadiusAction.setEnabled(false);
+    _moranPermutationAction.setToolTip("Permutation test p-values of Moran's I, shown in the gene tooltips of the bar chart");
+    _moranPermutationsAction.setToolTip("Maximum number of permutations of the Moran test, genes that are clearly not significant stop earlier");
+    _moranPermutationsAction.setEnabled(false);
 
     if (_geneSurferPlugin == nullptr)
         return;
@@ -39,6 +63,12 @@ CorrelationModeAction::CorrelationModeAction(QObject* parent, const QString& tit
         _geneSurferPlugin->updateSelection();
         });
 
+    connect(&_wilcoxonAction, &TriggerAction::triggered, [this, &corrFilter]() {
+        corrFilter.setFilterType(corrFilter::CorrFilterType::WILCOXON);
+        _geneSurferPlugin->updateFilterLabel();
+        _geneSurferPlugin->updateSelection();
+        });
+
     connect(&_moranAction, &TriggerAction::triggered, [this, &corrFilter]() {
         corrFilter.setFilterType(corrFilter::CorrFilterType::MORAN);
         _geneSurferPlugin->updateFilterLabel();
@@ -56,9 +86,55 @@ CorrelationModeAction::CorrelationModeAction(QObject* parent, const QString& tit
         _geneSurferPlugin->updateFilterLabel();
         _geneSurferPlugin->updateSelection();
         });
+
+    connect(&_moranWeightsAction, &OptionAction::currentIndexChanged, [this](int index) {
+        updateMoranSettings();
+        });
+
+    connect(&_moranNeighborsAction, &IntegralAction::valueChanged, [this](int32_t val) {
+        updateMoranSettings();
+        });
+
+    connect(&_moranRadiusAction, &DecimalAction::valueChanged, [this](float val) {
+        updateMoranSettings();
+        });
+
+    connect(&_moranPermutationAction, &ToggleAction::toggled, [this](bool toggled) {
+        updateMoranSettings();
+        });
+
+    connect(&_moranPermutationsAction, &IntegralAction::valueChanged, [this](int32_t val) {
+        updateMoranSettings();
+        });
    
 }
 
+void CorrelationModeAction::updateMoranSettings()
+{
+    if (_geneSurferPlugin == nullptr)
+        return;
+
+    corrFilter::CorrFilter& corrFilter = _geneSurferPlugin->getCorrFilter();
+
+    SpatialWeightSettings settings;
+    settings.type = static_cast<SpatialWeightType>(_moranWeightsAction.getCurrentIndex());
+    settings.numNeighbors = _moranNeighborsAction.getValue();
+    settings.radiusFactor = _moranRadiusAction.getValue();
+    corrFilter.getMoranFilter().setWeightSettings(settings);
+
+    corrFilter::MoranPermutationSettings permutationSettings;
+    permutationSettings.enabled = _moranPermutationAction.isChecked();
+    permutationSettings.maxPermutations = _moranPermutationsAction.getValue();
+    corrFilter.getMoranFilter().setPermutationSettings(permutationSettings);
+
+    _moranNeighborsAction.setEnabled(settings.type == SpatialWeightType::K_NEAREST);
+    _moranRadiusAction.setEnabled(settings.type == SpatialWeightType::RADIUS);
+    _moranPermutationsAction.setEnabled(permutationSettings.enabled);
+
+    if (corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN)
+        _geneSurferPlugin->updateSelection();
+}
+
 
 // void CorrelationModeAction::connectToPublicAction(WidgetAction* publicAction, bool recursive)
 // {
@@ -96,10 +172,18 @@ void CorrelationModeAction::fromVariantMap(const QVariantMap& variantMap)
 {
     VerticalGroupAction::fromVariantMap(variantMap);
 
+    _moranWeightsAction.fromParentVariantMap(variantMap);
+    _moranNeighborsAction.fromParentVariantMap(variantMap);
+    _moranRadiusAction.fromParentVariantMap(variantMap);
+    _moranPermutationAction.fromParentVariantMap(variantMap);
+    _moranPermutationsAction.fromParentVariantMap(variantMap);
+
     corrFilter::CorrFilter& corrFilter = _geneSurferPlugin->getCorrFilter();
 
     if (variantMap["FilterMode"] == "Diff")
         corrFilter.setFilterType(corrFilter::CorrFilterType::DIFF);
+    else if (variantMap["FilterMode"] == "Wilcoxon")
+        corrFilter.setFilterType(corrFilter::CorrFilterType::WILCOXON);
     else if (variantMap["FilterMode"] == "Moran")
         corrFilter.setFilterType(corrFilter::CorrFilterType::MORAN);
     else if (variantMap["FilterMode"] == "Spatial Z")
@@ -113,6 +197,12 @@ QVariantMap CorrelationModeAction::toVariantMap() const
 {
     auto variantMap = VerticalGroupAction::toVariantMap();
 
+    _moranWeightsAction.insertIntoVariantMap(variantMap);
+    _moranNeighborsAction.insertIntoVariantMap(variantMap);
+    _moranRadiusAction.insertIntoVariantMap(variantMap);
+    _moranPermutationAction.insertIntoVariantMap(variantMap);
+    _moranPermutationsAction.insertIntoVariantMap(variantMap);
+
     corrFilter::CorrFilter& corrFilter = _geneSurferPlugin->getCorrFilter();
 
     variantMap.insert("FilterMode", corrFilter.getCorrFilterTypeAsString());
@@ -2,6 +2,10 @@
 
 #include <actions/VerticalGroupAction.h>
 #include <actions/TriggerAction.h>
+#include <actions/OptionAction.h>
+#include <actions/IntegralAction.h>
+#include <actions/DecimalAction.h>
+#include <actions/ToggleAction.h>
 
 
 using namespace mv::gui;
@@ -45,14 +49,30 @@ public: // Serialization
 
 public: // Action getters
     TriggerAction& getDiffAction() { return _diffAction; }
+    TriggerAction& getWilcoxonAction() { return _wilcoxonAction; }
     TriggerAction& getMoranAction() { return _moranAction; }
+    OptionAction& getMoranWeightsAction() { return _moranWeightsAction; }
+    IntegralAction& getMoranNeighborsAction() { return _moranNeighborsAction; }
+    DecimalAction& getMoranRadiusAction() { return _moranRadiusAction; }
+    ToggleAction& getMoranPermutationAction() { return _moranPermutationAction; }
+    IntegralAction& getMoranPermutationsAction() { return _moranPermutationsAction; }
+
+private:
+    /** Pass the Moran weight and permutation settings to the filter and recompute if Moran's I is the current filter */
+    void updateMoranSettings();
 
 private:
     GeneSurferPlugin*   _geneSurferPlugin;     /** Pointer to the GeneSurfer plugin */
     TriggerAction       _diffAction;     /** Trigger action for activating the diff mode */
+    TriggerAction       _wilcoxonAction;     /** Trigger action for activating the rank-sum test mode */
     TriggerAction       _moranAction;     // experiment
     TriggerAction       _spatialCorrelationZAction;     // experiment
     TriggerAction       _spatialCorrelationYAction;     // experiment
+    OptionAction        _moranWeightsAction;     /** neighbours weighted by Moran's I action */
+    IntegralAction      _moranNeighborsAction;     /** number of nearest neighbours action */
+    DecimalAction       _moranRadiusAction;     /** neighbour radius, in mean nearest-neighbour distances action */
+    ToggleAction        _moranPermutationAction;     /** permutation test p-values of Moran's I action */
+    IntegralAction      _moranPermutationsAction;     /** maximum number of permutations action */
 
     //friend class mv::AbstractActionsManager;
 };
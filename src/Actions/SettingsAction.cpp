@@ -19,7 +19,8 @@ SettingsAction::SettingsAction(QObject* parent, const QString& title) :
     _clusteringAction(this, "Cluster Settings"),
     _sectionAction(this, "Section selection"),
     _correlationModeAction(this, "Gene filtering"),
-    _enrichmentAction(this, "Enrichment settings")
+    _enrichmentAction(this, "Enrichment settings"),
+    _storageAction(this, "Storage settings")
 {
     setText("Settings");
     setSerializationName("SettingsAction");
@@ -42,6 +43,7 @@ SettingsAction::SettingsAction(QObject* parent, const QString& title) :
         _singleCellModeAction.setEnabled(hasDataset);
         _dimensionSelectionAction.setEnabled(hasDataset);
         _enrichmentAction.setEnabled(hasDataset);
+        _storageAction.setEnabled(hasDataset);
     };
 
     connect(&_geneSurferPlugin->getPositionDataset(), &Dataset<Points>::changed, this, updateEnabled);
@@ -70,6 +72,10 @@ void SettingsAction::fromVariantMap(const QVariantMap& variantMap)
     _sliceDatasetPickerAction.fromParentVariantMap(variantMap);
     _avgExprDatasetPickerAction.fromParentVariantMap(variantMap);
 
+    // Storage settings are needed before the position dataset is ingested
+    if (variantMap.contains(_storageAction.getSerializationName()))
+        _storageAction.fromParentVariantMap(variantMap);
+
     // Load position dataset
     auto positionDataset = _positionDatasetPickerAction.getCurrentDataset();
     if (positionDataset.isValid())
@@ -126,6 +132,7 @@ QVariantMap SettingsAction::toVariantMap() const
     _sectionAction.insertIntoVariantMap(variantMap);
     _correlationModeAction.insertIntoVariantMap(variantMap);
     _enrichmentAction.insertIntoVariantMap(variantMap);
+    _storageAction.insertIntoVariantMap(variantMap);
 
     return variantMap;
 }
@@ -15,6 +15,7 @@
 #include "DimensionSelectionAction.h"
 #include "EnrichmentAction.h"
 #include "SectionAction.h"
+#include "StorageAction.h"
 
 using namespace mv::gui;
 
@@ -73,6 +74,8 @@ public: // Action getters
 
     EnrichmentAction& getEnrichmentAction() { return _enrichmentAction; }
 
+    StorageAction& getStorageAction() { return _storageAction; }
+
 private:
     GeneSurferPlugin*       _geneSurferPlugin;       /** Pointer to Gene Surfer Plugin */
 
@@ -96,4 +99,6 @@ private:
     SectionAction            _sectionAction;         /** section action */
 
     EnrichmentAction        _enrichmentAction;          /** enrichment action */
+
+    StorageAction           _storageAction;             /** storage action */
 };
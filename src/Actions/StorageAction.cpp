@@ -0,0 +1,69 @@
+#include "StorageAction.h"
+#include "src/GeneSurferPlugin.h"
+
+using namespace mv::gui;
+
+StorageAction::StorageAction(QObject* parent, const QString& title) :
+    VerticalGroupAction(parent, title),
+    _outOfCoreAction(this, "Memory-mapped storage", false),
+    _precisionAction(this, "Precision"),
+    _cacheAction(this, "Disk cache", false)
+{
+    setToolTip("Data storage settings");
+    setIcon(mv::util::StyledIcon("hdd"));
+    setConfigurationFlag(WidgetAction::ConfigurationFlag::ForceCollapsedInGroup);
+    setLabelSizingType(LabelSizingType::Auto);
+
+    addAction(&_outOfCoreAction);
+
+    _outOfCoreAction.setToolTip("Keep the expression data in memory-mapped files on disk, for datasets larger than RAM (Float 32 precision only)");
+
+    // order matches QuantizationType
+    _precisionAction.initialize(QStringList({ "Float 32", "Float 16", "8-bit" }), "Float 32");
+    _precisionAction.setToolTip("Precision of the stored expression data, lower precision needs less memory");
+    addAction(&_precisionAction);
+
+    _cacheAction.setToolTip("Store the standardized expression data on disk and reuse it when the same dataset is loaded again, every cached dataset takes as much disk space as its expression data");
+    addAction(&_cacheAction);
+
+    // quantized data is always kept in RAM, memory-mapped storage only applies to Float 32
+    connect(&_precisionAction, &OptionAction::currentIndexChanged, this, [this](int index) {
+        _outOfCoreAction.setEnabled(index == 0);
+        });
+
+    auto geneSurferPlugin = dynamic_cast<GeneSurferPlugin*>(parent->parent());
+    if (geneSurferPlugin == nullptr)
+        return;
+
+    connect(&_outOfCoreAction, &ToggleAction::toggled, [this, geneSurferPlugin](bool toggled) {
+        geneSurferPlugin->updateStorageMode();
+        });
+
+    connect(&_precisionAction, &OptionAction::currentIndexChanged, [this, geneSurferPlugin](int index) {
+        geneSurferPlugin->updateStorageMode();
+        });
+
+    connect(&_cacheAction, &ToggleAction::toggled, [this, geneSurferPlugin](bool toggled) {
+        geneSurferPlugin->updateStorageMode();
+        });
+}
+
+void StorageAction::fromVariantMap(const QVariantMap& variantMap)
+{
+    VerticalGroupAction::fromVariantMap(variantMap);
+
+    _outOfCoreAction.fromParentVariantMap(variantMap);
+    _precisionAction.fromParentVariantMap(variantMap);
+    _cacheAction.fromParentVariantMap(variantMap);
+}
+
+QVariantMap StorageAction::toVariantMap() const
+{
+    auto variantMap = VerticalGroupAction::toVariantMap();
+
+    _outOfCoreAction.insertIntoVariantMap(variantMap);
+    _precisionAction.insertIntoVariantMap(variantMap);
+    _cacheAction.insertIntoVariantMap(variantMap);
+
+    return variantMap;
+}
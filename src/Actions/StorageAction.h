@@ -0,0 +1,59 @@
+#pragma once
+#include <actions/VerticalGroupAction.h>
+#include <actions/ToggleAction.h>
+#include <actions/OptionAction.h>
+
+using namespace mv::gui;
+
+class GeneSurferPlugin;
+
+/**
+ * Storage setting action class
+ *
+ * Action class for choosing how the expression data is stored
+ */
+class StorageAction : public VerticalGroupAction
+{
+    Q_OBJECT
+
+
+public:
+
+    /**
+     * Construct with \p parent and \p title
+     * @param parent Pointer to parent object
+     * @param title Title of the action
+     */
+    Q_INVOKABLE StorageAction(QObject* parent, const QString& title);
+
+
+public: // Serialization
+
+    /**
+     * Load widget action from variant map
+     * @param Variant map representation of the widget action
+     */
+    void fromVariantMap(const QVariantMap& variantMap) override;
+
+    /**
+     * Save widget action to variant map
+     * @return Variant map representation of the widget action
+     */
+
+    QVariantMap toVariantMap() const override;
+
+public: // Action getters
+
+    ToggleAction& getOutOfCoreAction() { return _outOfCoreAction; }
+    OptionAction& getPrecisionAction() { return _precisionAction; }
+    ToggleAction& getCacheAction() { return _cacheAction; }
+
+private:
+    ToggleAction            _outOfCoreAction;        /** keep the base data in memory-mapped files action */
+    OptionAction            _precisionAction;        /** storage precision of the base data action */
+    ToggleAction            _cacheAction;            /** reuse the standardized base data from the disk cache action */
+};
+
+Q_DECLARE_METATYPE(StorageAction)
+
+inline const auto storageActionMetaTypeId = qRegisterMetaType<StorageAction*>("StorageAction");
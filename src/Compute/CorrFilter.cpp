@@ -3,6 +3,7 @@
 #include "graphics/Vector2f.h"
 #include "graphics/Vector3f.h"
 
+#include <algorithm>
 #include <numeric>
 #include <iostream>
 #include <fstream>
@@ -11,13 +12,301 @@
 #include <QDebug>
 
 #include <chrono>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string_view>
 
 using namespace mv;
 
 namespace
 {
-    float mean(const std::vector<float>& v) {
-        return std::accumulate(v.begin(), v.end(), 0.0) / v.size();
+    void normalizeContrast(Eigen::VectorXf& contrast, std::vector<float>& diffVector) {
+        // Norm to range [0, 1] for plotting in the bar chart
+        float minContrast = contrast.minCoeff();
+        float maxContrast = contrast.maxCoeff();
+        float rangeContrast = maxContrast - minContrast;
+
+        if (rangeContrast != 0) {
+            contrast = (contrast.array() - minContrast) / rangeContrast;
+        }
+        else {
+            contrast.setZero();
+        }
+
+        diffVector.clear();
+        diffVector.assign(contrast.data(), contrast.data() + contrast.size());
+    }
+
+    void moranVarianceTerms(float N, float W, float S1, float S2, float& S4, float& S5) {
+        float Wsq = W * W;
+        float Nsq = N * N;
+        S4 = (Nsq - 3 * N + 3) * S1 - N * S2 + 3 * Wsq;
+        S5 = (Nsq - N) * S1 - 2 * N * S2 + 6 * Wsq;
+    }
+
+    // Moran's I, its expected value and standard deviation of N centered values z with sum of z^2 sumz2, sum of z^4 sumz4
+    // and weighted cross product cv = z^T W z
+    std::vector<float> moranStatistics(size_t N, float cv, float sumz2, float sumz4, const float W, const float S4, const float S5) {
+        float Wsq = W * W;
+        float ei = -1.0f / (N - 1); // Expected value of Moran's I
+
+        float obs = (N / W) * (cv / sumz2); // Moran's I
+
+        float S3 = sumz4 / N / std::pow(sumz2 / N, 2);
+
+        float varI = ((N * S4 - S3 * S5) / ((N - 1) * (N - 2) * (N - 3) * Wsq)) - ei * ei; // Variance of Moran's I // TODO: check N > 3
+        float sd = sqrt(varI); // Standard deviation of Moran's I
+
+        return { obs, ei, sd };// Moran's I, Expected I, SD
+    }
+
+    // hash of the point coordinates and the weight settings, identifies the spatial weights of a flood
+    size_t computeWeightKey(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates, const SpatialWeightSettings& settings) {
+        size_t key = 0;
+        auto combine = [&key](size_t value) { key ^= value + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2); };
+
+        for (const std::vector<float>* coordinates : { &xCoordinates, &yCoordinates, &zCoordinates })
+            combine(std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(coordinates->data()), coordinates->size() * sizeof(float))));
+
+        combine(static_cast<size_t>(settings.type));
+        combine(static_cast<size_t>(settings.numNeighbors));
+        combine(std::hash<float>()(settings.radiusFactor));
+
+        return key;
+    }
+
+    bool sameWeightSettings(const SpatialWeightSettings& a, const SpatialWeightSettings& b) {
+        return a.type == b.type && a.numNeighbors == b.numNeighbors && a.radiusFactor == b.radiusFactor;
+    }
+
+    float moranZScore(const std::vector<float>& result) {
+        float moranI = result[0];
+        float expectedI = result[1];
+        float sd = result[2];
+        float zScore;
+        if (sd != 0)
+            zScore = (moranI - expectedI) / sd;
+        else
+            zScore = 0;
+
+        // Check if zScore is NaN   
+        if (std::isnan(zScore)) {
+            zScore = 0;
+        }
+
+        return zScore;
+    }
+
+    /**
+     * z-score of Moran's I of all columns of dataMatrix with the (dense or sparse) N x N weight
+     * The columns are centered once per block of genes and cv = diag(Z^T W Z) is one matrix product per block,
+     * so the weights are streamed once per block instead of once per gene
+     */
+    template<typename WeightMatrix>
+    void computeMoranZScores(const DataMatrix& dataMatrix, const WeightMatrix& weight, const float W, const float S4, const float S5, std::vector<float>& moranVector) {
+        const int N = dataMatrix.rows();
+        const int numGenes = dataMatrix.cols();
+        constexpr int blockSize = 64;
+        const int numBlocks = (numGenes + blockSize - 1) / blockSize;
+
+        moranVector.resize(numGenes);
+
+#pragma omp parallel for schedule(dynamic)
+        for (int block = 0; block < numBlocks; ++block) {
+            const int firstGene = block * blockSize;
+            const int numBlockGenes = std::min(blockSize, numGenes - firstGene);
+
+            const Eigen::RowVectorXf means = dataMatrix.middleCols(firstGene, numBlockGenes).colwise().mean();
+            const DataMatrix Z = dataMatrix.middleCols(firstGene, numBlockGenes).rowwise() - means;
+            const DataMatrix WZ = weight * Z;
+
+            const Eigen::RowVectorXf cv = Z.cwiseProduct(WZ).colwise().sum();
+            const Eigen::RowVectorXf sumz2 = Z.colwise().squaredNorm();
+            const Eigen::RowVectorXf sumz4 = Z.array().square().square().colwise().sum();
+
+            for (int g = 0; g < numBlockGenes; ++g)
+                moranVector[firstGene + g] = moranZScore(moranStatistics(N, cv[g], sumz2[g], sumz4[g], W, S4, S5));
+        }
+    }
+
+    using RowMajorDataMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    // z^T W z of every column of data with its rows permuted, dense weights as one matrix product
+    void permutedCrossProducts(const DataMatrix& weight, const RowMajorDataMatrix& data, const std::vector<int>& permutation, Eigen::RowVectorXf& cv) {
+        DataMatrix permuted(data.rows(), data.cols());
+        for (int i = 0; i < data.rows(); ++i)
+            permuted.row(i) = data.row(permutation[i]);
+
+        cv = permuted.cwiseProduct(weight * permuted).colwise().sum();
+    }
+
+    // sparse weights read the permuted rows in place, a row of neighbour sums is all that is kept
+    void permutedCrossProducts(const SpatialWeightMatrix& weight, const RowMajorDataMatrix& data, const std::vector<int>& permutation, Eigen::RowVectorXf& cv) {
+        Eigen::RowVectorXf neighborSum(data.cols());
+        cv.setZero(data.cols());
+
+        for (int i = 0; i < weight.outerSize(); ++i) {
+            neighborSum.setZero();
+            for (SpatialWeightMatrix::InnerIterator it(weight, i); it; ++it)
+                neighborSum += it.value() * data.row(permutation[it.col()]);
+
+            cv += data.row(permutation[i]).cwiseProduct(neighborSum);
+        }
+    }
+
+    /**
+     * Two-sided permutation p-values of Moran's I of all columns of dataMatrix
+     * Batches of random permutations of the points are evaluated as products of the weight with row-permuted blocks of genes,
+     * spread over all cores. A gene stops as soon as stopExceedances permutations were at least as extreme as the observation
+     * (the sequential test of Besag and Clifford), so only the genes with small p-values run all permutations
+     */
+    template<typename WeightMatrix>
+    void computeMoranPermutationPValues(const DataMatrix& dataMatrix, const WeightMatrix& weight, const corrFilter::MoranPermutationSettings& settings, std::vector<float>& pValues) {
+        const int N = dataMatrix.rows();
+        const int numGenes = dataMatrix.cols();
+        constexpr int blockSize = 64;
+        constexpr int batchSize = 32;
+
+        pValues.assign(numGenes, 1.0f);
+        if (N < 4 || settings.maxPermutations < 1)
+            return;
+
+        // sum z^2 is the same for every permutation, so z^T W z decides alone how extreme a permutation is
+        const Eigen::RowVectorXf means = dataMatrix.colwise().mean();
+        const DataMatrix Z = dataMatrix.rowwise() - means;
+        const Eigen::RowVectorXf sumz2 = Z.colwise().squaredNorm();
+        const float W = weight.sum();
+
+        // deviation of the observed z^T W z from its expected value (the expected I = -1 / (N - 1))
+        Eigen::RowVectorXf expected = sumz2 * (-1.0f / (N - 1)) * W / N;
+        Eigen::RowVectorXf observedDeviation(numGenes);
+        for (int firstGene = 0; firstGene < numGenes; firstGene += blockSize) {
+            const int numBlockGenes = std::min(blockSize, numGenes - firstGene);
+            const auto block = Z.middleCols(firstGene, numBlockGenes);
+            observedDeviation.segment(firstGene, numBlockGenes) = (block.cwiseProduct(weight * block).colwise().sum() - expected.segment(firstGene, numBlockGenes)).cwiseAbs();
+        }
+
+        // ties count as at least as extreme, up to float rounding
+        const Eigen::RowVectorXf threshold = observedDeviation * (1.0f - 1e-5f);
+
+        std::vector<int> exceedances(numGenes, 0);
+        std::vector<int> numPermutations(numGenes, 0);
+
+        std::vector<int> active;
+        for (int g = 0; g < numGenes; ++g)
+            if (sumz2[g] > 0)
+                active.push_back(g);
+
+        std::vector<std::vector<int>> permutations(batchSize, std::vector<int>(N));
+
+        // blocks of the active genes side by side per point, so a permuted point is one contiguous row of a block that stays in cache
+        std::vector<RowMajorDataMatrix> activeBlocks;
+        int numActiveBlocked = 0;
+
+        for (int firstPermutation = 0; firstPermutation < settings.maxPermutations && !active.empty(); firstPermutation += batchSize) {
+            const int numBatchPermutations = std::min(batchSize, settings.maxPermutations - firstPermutation);
+
+            // seeded per permutation, so the p-values do not depend on the number of threads
+#pragma omp parallel for
+            for (int b = 0; b < numBatchPermutations; ++b) {
+                std::iota(permutations[b].begin(), permutations[b].end(), 0);
+                std::mt19937 generator(settings.seed + firstPermutation + b);
+                std::shuffle(permutations[b].begin(), permutations[b].end(), generator);
+            }
+
+            const int numActive = active.size();
+            const int numBlocks = (numActive + blockSize - 1) / blockSize;
+            std::vector<int> batchExceedances(numActive, 0);
+
+            if (numActiveBlocked != numActive) {
+                activeBlocks.resize(numBlocks);
+                for (int block = 0; block < numBlocks; ++block) {
+                    const int firstActive = block * blockSize;
+                    activeBlocks[block].resize(N, std::min(blockSize, numActive - firstActive));
+                    for (int g = 0; g < activeBlocks[block].cols(); ++g)
+                        activeBlocks[block].col(g) = Z.col(active[firstActive + g]);
+                }
+                numActiveBlocked = numActive;
+            }
+
+#pragma omp parallel for schedule(dynamic)
+            for (int task = 0; task < numBatchPermutations * numBlocks; ++task) {
+                const int block = task % numBlocks;
+                const int firstActive = block * blockSize;
+
+                Eigen::RowVectorXf cv;
+                permutedCrossProducts(weight, activeBlocks[block], permutations[task / numBlocks], cv);
+
+                for (int g = 0; g < cv.size(); ++g) {
+                    const int gene = active[firstActive + g];
+                    if (std::abs(cv[g] - expected[gene]) >= threshold[gene]) {
+#pragma omp atomic
+                        batchExceedances[firstActive + g]++;
+                    }
+                }
+            }
+
+            std::vector<int> stillActive;
+            for (int i = 0; i < numActive; ++i) {
+                const int g = active[i];
+                exceedances[g] += batchExceedances[i];
+                numPermutations[g] += numBatchPermutations;
+                if (exceedances[g] < settings.stopExceedances)
+                    stillActive.push_back(g);
+            }
+            active.swap(stillActive);
+        }
+
+        for (int g = 0; g < numGenes; ++g)
+            if (numPermutations[g] > 0)
+                pValues[g] = (exceedances[g] + 1.0f) / (numPermutations[g] + 1.0f);
+    }
+
+    /**
+     * Correlation matrix of the columns of \p centered (centered and, if weighted, scaled by the square roots of the weights)
+     *
+     * The columns are normalized in place and the correlations are their Gram matrix, computed as a symmetric rank-k update.
+     * Eigen does not thread the triangular product, so the lower triangle is split into blocks of genes that are computed
+     * in parallel, rank updates on the diagonal and blocked matrix products below it. Columns without variance correlate 0
+     * with every column, as the NaN correlations did
+     */
+    void correlationFromCentered(DataMatrix& centered, DataMatrix& corrMatrix)
+    {
+        const int numDims = centered.cols();
+
+#pragma omp parallel for
+        for (int i = 0; i < numDims; ++i) {
+            const float norm = centered.col(i).norm();
+            centered.col(i) *= norm > 0 ? 1.0f / norm : 0.0f;
+        }
+
+        constexpr int blockSize = 256;
+        const int numBlocks = (numDims + blockSize - 1) / blockSize;
+
+        std::vector<std::pair<int, int>> blockPairs;
+        for (int b1 = 0; b1 < numBlocks; ++b1)
+            for (int b2 = 0; b2 <= b1; ++b2)
+                blockPairs.emplace_back(b1, b2);
+
+        corrMatrix.setZero(numDims, numDims);
+
+#pragma omp parallel for schedule(dynamic)
+        for (int task = 0; task < static_cast<int>(blockPairs.size()); ++task) {
+            const auto [b1, b2] = blockPairs[task];
+            const int first1 = b1 * blockSize;
+            const int first2 = b2 * blockSize;
+            const int size1 = std::min(blockSize, numDims - first1);
+            const int size2 = std::min(blockSize, numDims - first2);
+
+            auto block = corrMatrix.block(first1, first2, size1, size2);
+            if (b1 == b2)
+                block.selfadjointView<Eigen::Lower>().rankUpdate(centered.middleCols(first1, size1).transpose());
+            else
+                block.noalias() = centered.middleCols(first1, size1).transpose() * centered.middleCols(first2, size2);
+        }
+
+        corrMatrix.triangularView<Eigen::StrictlyUpper>() = corrMatrix.transpose();
     }
 
     void normalizeWeightMatrix(std::vector<std::vector<float>>& weight) {
@@ -46,30 +335,16 @@ namespace corrFilter
         //qDebug() << "dataMatrix.rows(): " << dataMatrix.rows() << " dataMatrix.cols(): " << dataMatrix.cols();
 
         // TO DO: dimNames not needed
-        std::vector<Eigen::VectorXf> centeredVectors(dimNames.size());// precompute mean 
-        std::vector<float> norms(dimNames.size());
-
-        for (int i = 0; i < dimNames.size(); ++i) {
-            //int index = dimNameToIndex[dimNames[i]];
-            //int index = dimNameToIndex.at(dimNames[i]);
-            int index = dimIndices[i];
-            Eigen::VectorXf centered = dataMatrix.col(index) - Eigen::VectorXf::Constant(dataMatrix.col(index).size(), dataMatrix.col(index).mean());
-            centeredVectors[i] = centered;
-            norms[i] = centered.squaredNorm();
-        }
-
-        //qDebug() << "Compute centeredVectors and norms finished...";
+        const int numDims = dimIndices.size();
+        DataMatrix centered(dataMatrix.rows(), numDims);
 
-        #pragma omp parallel for
-        for (int col1 = 0; col1 < dimNames.size(); ++col1) {
-            for (int col2 = col1; col2 < dimNames.size(); ++col2) {
-                float correlation = centeredVectors[col1].dot(centeredVectors[col2]) / std::sqrt(norms[col1] * norms[col2]);
-                if (std::isnan(correlation)) { correlation = 0.0f; } // TO DO: check if this is a good way to handle nan in corr computation
-
-                corrMatrix(col1, col2) = correlation;
-                corrMatrix(col2, col1) = correlation;
-            }
+#pragma omp parallel for
+        for (int i = 0; i < numDims; ++i) {
+            const auto column = dataMatrix.col(dimIndices[i]);
+            centered.col(i) = column.array() - column.mean();
         }
+
+        correlationFromCentered(centered, corrMatrix);
         //qDebug() << "Compute pairwise correlation finished...";
     }
 
@@ -87,39 +362,55 @@ namespace corrFilter
             return;
         }
 
-        // Precompute weighted centered vectors and norms
-        std::vector<Eigen::VectorXf> centeredVectors(dimNames.size());
-        std::vector<float> norms(dimNames.size());
+        // the square roots of the weights once, every column is centered and scaled into one matrix
+        const int numDims = dimIndices.size();
+        const Eigen::ArrayXf sqrtWeights = weights.array().sqrt();
+        const float weightSum = weights.sum();
 
-        for (int i = 0; i < dimNames.size(); ++i) {
-            int index = dimIndices[i];
+        DataMatrix weightedCentered(dataMatrix.rows(), numDims);
 
-            // Compute weighted mean of the column
-            float weightedMean = (weights.array() * dataMatrix.col(index).array()).sum() / weights.sum();
-
-            // Compute weighted centered vector
-            Eigen::VectorXf centered = dataMatrix.col(index).array() - weightedMean;
-            Eigen::VectorXf weightedCentered = centered.array() * weights.array().sqrt();
-            centeredVectors[i] = weightedCentered;
-            norms[i] = weightedCentered.squaredNorm();
+#pragma omp parallel for
+        for (int i = 0; i < numDims; ++i) {
+            const auto column = dataMatrix.col(dimIndices[i]);
+            const float weightedMean = column.dot(weights) / weightSum;
+            weightedCentered.col(i) = (column.array() - weightedMean) * sqrtWeights;
         }
 
-        //qDebug() << "Compute centeredVectors and norms finished...";
+        correlationFromCentered(weightedCentered, corrMatrix);
 
-#pragma omp parallel for
-        for (int col1 = 0; col1 < dimNames.size(); ++col1) {
-            for (int col2 = col1; col2 < dimNames.size(); ++col2) {
-                float weightedDotProduct = (centeredVectors[col1].array() * centeredVectors[col2].array()).sum();
-                float correlation = weightedDotProduct / std::sqrt(norms[col1] * norms[col2]);
-                if (std::isnan(correlation)) { correlation = 0.0f; } // Handle NaN in correlation computation
-
-                corrMatrix(col1, col2) = correlation;
-                corrMatrix(col2, col1) = correlation;
+        //qDebug() << "Compute pairwise correlation finished...";
+    
+    }
+
+    void CorrFilter::computePairwiseCorrelationVector(const std::vector<int>& dimIndices, const SparseDataMatrix& dataMatrix, const std::vector<int>& rowIndices, DataMatrix& corrMatrix) const
+    {   // sparse data, without weighting
+        const int numDims = dimIndices.size();
+        const int numRows = rowIndices.size();
+
+        std::vector<int> rowToSubset(dataMatrix.rows(), -1);
+        for (int i = 0; i < numRows; ++i)
+            rowToSubset[rowIndices[i]] = i;
+
+        // sparse subset of the requested columns and rows
+        std::vector<Eigen::Triplet<float>> triplets;
+        for (int i = 0; i < numDims; ++i) {
+            for (SparseDataMatrix::InnerIterator it(dataMatrix, dimIndices[i]); it; ++it) {
+                int row = rowToSubset[it.index()];
+                if (row >= 0)
+                    triplets.emplace_back(row, i, it.value());
             }
         }
+        SparseDataMatrix subset(numRows, numDims);
+        subset.setFromTriplets(triplets.begin(), triplets.end());
 
-        //qDebug() << "Compute pairwise correlation finished...";
-    
+        // covariance from the sparse Gram matrix, column offsets cancel in the correlation
+        DataMatrix gram = DataMatrix(subset.transpose() * subset);
+        Eigen::VectorXf sums = subset.transpose() * Eigen::VectorXf::Ones(numRows);
+        DataMatrix covariance = gram - sums * sums.transpose() / numRows;
+
+        // scaled by the inverse standard deviations on both sides, columns without variance correlate 0
+        const Eigen::VectorXf inverseNorms = covariance.diagonal().unaryExpr([](float variance) { return variance > 0 ? 1.0f / std::sqrt(variance) : 0.0f; });
+        corrMatrix = inverseNorms.asDiagonal() * covariance * inverseNorms.asDiagonal();
     }
 
     QString CorrFilter::getCorrFilterTypeAsString() const
@@ -133,6 +424,8 @@ namespace corrFilter
             return "Spatial Z";
         case CorrFilterType::SPATIALY:
             return "Spatial Y";
+        case CorrFilterType::WILCOXON:
+            return "Wilcoxon";
         default: 
             return "Unknown";
         }
@@ -141,8 +434,7 @@ namespace corrFilter
     void SpatialCorr::computeCorrelationVectorOneDimension(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<float>& positionsOneDimension, std::vector<float>& corrVector) const
     {
         // 2D or 3D all flood indices
-        //qDebug() << "Compute spatial correlation started...";
-        Eigen::VectorXf vector(floodIndices.size());
+        DataMatrix positions(floodIndices.size(), 1);
         for (int i = 0; i < floodIndices.size(); ++i) {
             int index = floodIndices[i];
             if (index >= positionsOneDimension.size())
@@ -150,107 +442,98 @@ namespace corrFilter
                 qDebug() << "ERROR CorrFilter::computeCorrelationVector: index: " << index << " >= positionsOneDimension.size(): " << positionsOneDimension.size();
                 return;
             }
-            vector[i] = positionsOneDimension[index];
+            positions(i, 0) = positionsOneDimension[index];
         }
-        //qDebug() << "vector size" << vector.size();
 
-        // Precompute means and norms
-        float mean = vector.mean();
-        Eigen::VectorXf centered = vector - Eigen::VectorXf::Constant(vector.size(), mean);
-        float norm = centered.squaredNorm();
-        //qDebug() << "Compute centeredVectors and norms finished...";
+        Eigen::MatrixXf correlations;
+        computeCorrelationMatrix(dataMatrix, positions, Eigen::VectorXf(), correlations);
 
-        std::vector<float> correlations(dataMatrix.cols());
-
-        corrVector.clear();
-        corrVector.resize(dataMatrix.cols());
+        corrVector.assign(correlations.data(), correlations.data() + correlations.rows());
+    }
 
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i) {
-            Eigen::VectorXf column = dataMatrix.col(i);
-            float meanColumn = column.mean();
-            Eigen::VectorXf centeredColumn = column - Eigen::VectorXf::Constant(column.size(), meanColumn);
-            float normColumn = centeredColumn.squaredNorm();
-            float correlation = centeredColumn.dot(centered) / std::sqrt(normColumn * norm);
-            if (std::isnan(correlation)) { correlation = 0.0f; }
-            corrVector[i] = correlation;
+    void SpatialCorr::computeCorrelationVectorOneDimension(const FloodMoments& floodMoments, int axis, std::vector<float>& corrVector) const
+    {
+        // 2D or 3D all flood indices, the moments are already up to date with the flood
+        Eigen::MatrixXf correlations = floodMoments.positionCorrelation();
+        if (axis < 0 || axis >= correlations.cols())
+        {
+            qDebug() << "ERROR CorrFilter::computeCorrelationVectorOneDimension: axis: " << axis << " is not in the " << correlations.cols() << " axes of the flood moments";
+            corrVector.assign(floodMoments.getNumGenes(), 0.0f);
+            return;
         }
-        //qDebug() << "corrVector size " << corrVector.size();
+
+        corrVector.assign(correlations.col(axis).data(), correlations.col(axis).data() + correlations.rows());
     }
 
     void SpatialCorr::computeCorrelationVectorOneDimension(const DataMatrix& dataMatrix, std::vector<float>& positionsOneDimension, std::vector<float>& corrVector) const
     {
         // 3D cluster with mean position
-        Eigen::VectorXf vector = Eigen::Map<Eigen::VectorXf>(positionsOneDimension.data(), positionsOneDimension.size());
+        const DataMatrix positions = Eigen::Map<const Eigen::VectorXf>(positionsOneDimension.data(), positionsOneDimension.size());
 
-        // Precompute means and norms for xVector, yVector, zVector
-        float mean = vector.mean();
-        Eigen::VectorXf centered = vector - Eigen::VectorXf::Constant(vector.size(), mean);
-        float norm = centered.squaredNorm();
+        Eigen::MatrixXf correlations;
+        computeCorrelationMatrix(dataMatrix, positions, Eigen::VectorXf(), correlations);
 
-        std::vector<float> correlations(dataMatrix.cols());
-
-        corrVector.clear();
-        corrVector.resize(dataMatrix.cols());
-
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i) {
-            Eigen::VectorXf column = dataMatrix.col(i);
-            float meanColumn = column.mean();
-            Eigen::VectorXf centeredColumn = column - Eigen::VectorXf::Constant(column.size(), meanColumn);
-            float normColumn = centeredColumn.squaredNorm();
-            float correlation = centeredColumn.dot(centered) / std::sqrt(normColumn * norm);
-            if (std::isnan(correlation)) { correlation = 0.0f; } 
-            corrVector[i] = correlation;
-        }
+        corrVector.assign(correlations.data(), correlations.data() + correlations.rows());
     }
 
     void SpatialCorr::computeCorrelationVectorOneDimension(const DataMatrix& dataMatrix, std::vector<float>& positionsOneDimension, const Eigen::VectorXf& weights, std::vector<float>& corrVector) const
     {
-        // test with weighting
-        // 3D cluster with mean position
-         
-        // check if the size of weights is the same as positionsOneDimension
+        // 3D cluster with mean position, weighted
         if (weights.size() != positionsOneDimension.size())
         {
             qDebug() << "ERROR CorrFilter::computeCorrelationVectorOneDimension: weights.size(): " << weights.size() << " != positionsOneDimension.size(): " << positionsOneDimension.size();
             return;
         }
-      
-        Eigen::VectorXf vector = Eigen::Map<Eigen::VectorXf>(positionsOneDimension.data(), positionsOneDimension.size());
 
-        // Compute weighted mean for vector
-        float weightedMean = (weights.array() * vector.array()).sum() / weights.sum();
+        const DataMatrix positions = Eigen::Map<const Eigen::VectorXf>(positionsOneDimension.data(), positionsOneDimension.size());
 
-        // Compute weighted centered vector and norm
-        Eigen::VectorXf centered = vector.array() - weightedMean;
-        Eigen::VectorXf weightedCentered = centered.array() * weights.array().sqrt();
-        float norm = weightedCentered.squaredNorm();
+        Eigen::MatrixXf correlations;
+        computeCorrelationMatrix(dataMatrix, positions, weights, correlations);
 
-        std::vector<float> correlations(dataMatrix.cols());
+        corrVector.assign(correlations.data(), correlations.data() + correlations.rows());
+    }
 
-        corrVector.clear();
-        corrVector.resize(dataMatrix.cols());
+    void SpatialCorr::computeCorrelationMatrix(const DataMatrix& dataMatrix, const DataMatrix& positions, const Eigen::VectorXf& weights, Eigen::MatrixXf& correlations) const
+    {
+        const int numRows = dataMatrix.rows();
+        const int numGenes = dataMatrix.cols();
+        const int numAxes = positions.cols();
 
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i) {
-            Eigen::VectorXf column = dataMatrix.col(i);
+        correlations.setZero(numGenes, numAxes);
 
-            // Compute weighted mean of the column
-            float meanColumn = (weights.array() * column.array()).sum() / weights.sum();
+        if (positions.rows() != numRows || (weights.size() != 0 && weights.size() != numRows))
+        {
+            qDebug() << "ERROR CorrFilter::computeCorrelationMatrix: " << numRows << " rows of data, " << positions.rows() << " positions and " << weights.size() << " weights";
+            return;
+        }
 
-            // Compute weighted centered column and norm
-            Eigen::VectorXf centeredColumn = column.array() - meanColumn;
-            Eigen::VectorXf weightedCenteredColumn = centeredColumn.array() * weights.array().sqrt();
-            float normColumn = weightedCenteredColumn.squaredNorm();
+        if (numRows == 0)
+            return;
 
-            // Compute the weighted dot product
-            float weightedDotProduct = (weightedCenteredColumn.array() * weightedCentered.array()).sum();
+        const Eigen::VectorXf rowWeights = weights.size() == numRows ? weights : Eigen::VectorXf::Ones(numRows);
+        const float weightSum = rowWeights.sum();
 
-            float correlation = weightedDotProduct / std::sqrt(normColumn * norm);
+        // weighted centered positions, so X^T (w * p) is the covariance without centering X, and the weights for the weighted sum of X
+        const Eigen::RowVectorXf positionMean = (rowWeights.transpose() * positions) / weightSum;
+        DataMatrix weightedPositions(numRows, numAxes + 1);
+        weightedPositions.leftCols(numAxes) = (positions.rowwise() - positionMean).array().colwise() * rowWeights.array();
+        weightedPositions.col(numAxes) = rowWeights;
 
-            if (std::isnan(correlation)) { correlation = 0.0f; }
-            corrVector[i] = correlation;
+        const Eigen::RowVectorXf positionNorm = ((positions.rowwise() - positionMean).array().square().colwise() * rowWeights.array()).colwise().sum();
+
+        // the cross moments with all axes and the weighted sums of all genes as one product
+        const DataMatrix products = dataMatrix.transpose() * weightedPositions;
+
+#pragma omp parallel for
+        for (int g = 0; g < numGenes; ++g) {
+            // the norm around the weighted mean, read from the column in place
+            const float mean = products(g, numAxes) / weightSum;
+            const float norm = ((dataMatrix.col(g).array() - mean).square() * rowWeights.array()).sum();
+
+            for (int a = 0; a < numAxes; ++a) {
+                const float correlation = products(g, a) / std::sqrt(norm * positionNorm[a]);
+                correlations(g, a) = std::isfinite(correlation) ? correlation : 0.0f;
+            }
         }
     }
 
@@ -327,58 +610,30 @@ namespace corrFilter
             S2 += std::pow((rs + cs), 2); // or S2 += (rs + cs) * (rs + cs);
         }
         S1 = S1 / 2;
-        float Wsq = W * W;
-        float Nsq = N * N;
-        S4 = (Nsq - 3 * N + 3) * S1 - N * S2 + 3 * Wsq;
-        S5 = (Nsq - N) * S1 - 2 * N * S2 + 6 * Wsq;
+        moranVarianceTerms(N, W, S1, S2, S4, S5);
     }
 
-    std::vector<float> Moran::moranTest_C(const std::vector<float>& x, std::vector<std::vector<float>>& weight, const float W, const float S1, const float S2, const float S4, const float S5)
+    void Moran::moranParameters(const SpatialWeightMatrix& weight, float& W, float& S1, float& S2, float& S4, float& S5)
     {
+        size_t N = weight.rows();// number of spatial units indexed by i and j
 
-        size_t N = weight.size();// number of spatial units indexed by i and j
+        W = weight.sum(); // sum of weights
 
-        // weight should be normalized
-        // weight has al been normalized in computeWeightMatrix()
-        //std::vector<std::vector<float>> normWeight = weight;
-        //normalizeWeightMatrix(normWeight);
+        // only pairs with a weight in either direction contribute to S1
+        SpatialWeightMatrix symmetricWeight = weight + SpatialWeightMatrix(weight.transpose());
+        S1 = symmetricWeight.squaredNorm() / 2;
 
-        // Calculate mean of x
-        float xMean = mean(x);
-        std::vector<float> z(N); // vector z = x - xMean
-        std::transform(x.begin(), x.end(), z.begin(), [xMean](float xi) { return xi - xMean; });
+        Eigen::VectorXf ones = Eigen::VectorXf::Ones(N);
+        Eigen::VectorXf rowSums = weight * ones;
+        Eigen::VectorXf colSums = weight.transpose() * ones;
+        S2 = (rowSums + colSums).squaredNorm();
 
-        //auto start1 = std::chrono::high_resolution_clock::now();
-        float cv = 0.0f;
-        for (size_t i = 0; i < N; ++i) {
-            for (size_t j = 0; j < N; ++j) {
-                cv += weight[i][j] * z[i] * z[j];
-            }
-        }
-        //auto end1 = std::chrono::high_resolution_clock::now();
-        //std::chrono::duration<double> elapsed1 = end1 - start1;
-        //qDebug() << "Elapsed time for cv: " << elapsed1.count();
-
-        float Wsq = W * W;
-        float ei = -1.0f / (N - 1); // Expected value of Moran's I
-
-        float sumz2 = std::accumulate(z.begin(), z.end(), 0.0f, [](float acc, float x) { return acc + x * x; }); // sum of z^2
-        float obs = (N / W) * (cv / sumz2); // Moran's I
-
-        float sumz4 = std::accumulate(z.begin(), z.end(), 0.0f, [](float acc, float x) { return acc + std::pow(x, 4); });// sum of z^4
-        float S3 = sumz4 / N / std::pow(sumz2 / N, 2);
-
-        float varI = ((N * S4 - S3 * S5) / ((N - 1) * (N - 2) * (N - 3) * Wsq)) - ei * ei; // Variance of Moran's I // TODO: check N > 3
-        float sd = sqrt(varI); // Standard deviation of Moran's I
-
-        std::vector<float> results = { obs, ei, sd };// Moran's I, Expected I, SD
-        return results;
+        moranVarianceTerms(N, W, S1, S2, S4, S5);
     }
 
     void Moran::computeMoranVector(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<mv::Vector2f>& positions, std::vector<float>& moranVector)
     {
         // 2D
-        qDebug() << "Compute moran's I started...";
         std::vector<float> xCoordinates;
         std::vector<float> yCoordinates;
 
@@ -388,63 +643,13 @@ namespace corrFilter
             xCoordinates.push_back(positions[index].x);
             yCoordinates.push_back(positions[index].y);
         }
-        std::vector<std::vector<float>> distanceMat = computeWeightMatrix(xCoordinates, yCoordinates);
-        //qDebug() << "Compute distance matrix finished...";
-
-        // compute weight-related parameters 
-        float W, S1, S2, S4, S5;
-        moranParameters(distanceMat, W, S1, S2, S4, S5);
-
-        moranVector.clear();
-        moranVector.resize(dataMatrix.cols());
-
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i)
-        {
-            auto col = dataMatrix.col(i);
-            std::vector<float> geneExpression;
-            geneExpression.assign(col.data(), col.data() + col.size());
-
-            std::vector<float> result = moranTest_C(geneExpression, distanceMat, W, S1, S2, S4, S5);
-
-            float moranI = result[0];
-            float expectedI = result[1];
-            float sd = result[2];
-            float zScore;
-            if (sd != 0)
-                zScore = (moranI - expectedI) / sd;
-            else
-                zScore = 0;
 
-            // Check if zScore is NaN   
-            if (std::isnan(zScore)) {
-                zScore = 0;
-                //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: nan";
-            }
-
-            //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: " << zScore;
-            moranVector[i] = zScore;
-        }
-        qDebug() << "Compute moran's I finished...";
-
-        // normalize the correlation vector to 0 to 1for plotting in the bar chart
-        //float minCorr = *std::min_element(moranVector.begin(), moranVector.end());
-        //float maxCorr = *std::max_element(moranVector.begin(), moranVector.end());
-        //qDebug() << "minCorr: " << minCorr << " maxCorr: " << maxCorr;
-
-       /* for (int i = 0; i < moranVector.size(); ++i) {
-            moranVector[i] = (moranVector[i] - minCorr) / (maxCorr - minCorr);
-        }
-        qDebug() << "Normalize moran's I finished...";*/
+        computeMoranVectorAtCoordinates(dataMatrix, xCoordinates, yCoordinates, {}, moranVector);
     }
 
     void Moran::computeMoranVector(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<float>& xPositions, const std::vector<float>& yPositions, const std::vector<float>& zPositions, std::vector<float>& moranVector)
     {
         //3D all flood indices
-        qDebug() << "Compute moran's I started...";
-
-        //auto start1 = std::chrono::high_resolution_clock::now();
-
         std::vector<float> xCoordinates;
         std::vector<float> yCoordinates;
         std::vector<float> zCoordinates;
@@ -462,138 +667,83 @@ namespace corrFilter
             yCoordinates.push_back(yPositions[index]);
             zCoordinates.push_back(zPositions[index]);
         }
-        std::vector<std::vector<float>> distanceMat = computeWeightMatrix(xCoordinates, yCoordinates, zCoordinates);
-
-        //auto end1 = std::chrono::high_resolution_clock::now();
-        //std::chrono::duration<double> elapsed1 = end1 - start1;
-        //qDebug() << "Elapsed time for computeWeightMatrix: " << elapsed1.count();
-        //qDebug() << "Compute distance matrix finished...";
-
-        // compute weight-related parameters 
-        //auto start2 = std::chrono::high_resolution_clock::now();
-
-        float W, S1, S2, S4, S5;
-        moranParameters(distanceMat, W, S1, S2, S4, S5);
-
-        //auto end2 = std::chrono::high_resolution_clock::now();
-        //std::chrono::duration<double> elapsed2 = end2 - start2;
-        //qDebug() << "Elapsed time for moranParameters: " << elapsed2.count();
 
-        //auto start3 = std::chrono::high_resolution_clock::now();
-
-        moranVector.clear();
-        moranVector.resize(dataMatrix.cols());
-
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i)
-        {
-            auto col = dataMatrix.col(i);
-            std::vector<float> geneExpression;
-            geneExpression.assign(col.data(), col.data() + col.size());
-            std::vector<float> result = moranTest_C(geneExpression, distanceMat, W, S1, S2, S4, S5);
-
-            float moranI = result[0];
-            float expectedI = result[1];
-            float sd = result[2];
-            float zScore;
-            if (sd != 0)
-                zScore = (moranI - expectedI) / sd;
-            else
-                zScore = 0;
-
-            // Check if zScore is NaN   
-            if (std::isnan(zScore)) {
-                zScore = 0;
-                //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: nan";
-            }
-
-            //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: " << zScore;
-            moranVector[i] = zScore;
-        }
-
-        //auto end3 = std::chrono::high_resolution_clock::now();
-        //std::chrono::duration<double> elapsed3 = end3 - start3;
-        //qDebug() << "Elapsed time for computeMoranVector: " << elapsed3.count();
-
-        qDebug() << "Compute moran's I finished...";
-
-        // normalize the correlation vector to 0 to 1for plotting in the bar chart
-        //auto start4 = std::chrono::high_resolution_clock::now();
-
-        //float minCorr = *std::min_element(moranVector.begin(), moranVector.end());
-        //float maxCorr = *std::max_element(moranVector.begin(), moranVector.end());
-        ////qDebug() << "minCorr: " << minCorr << " maxCorr: " << maxCorr;
-
-        //for (int i = 0; i < moranVector.size(); ++i) {
-        //    moranVector[i] = (moranVector[i] - minCorr) / (maxCorr - minCorr);
-        //}
-
-        ////auto end4 = std::chrono::high_resolution_clock::now();
-        ////std::chrono::duration<double> elapsed4 = end4 - start4;
-        ////qDebug() << "Elapsed time for normalize: " << elapsed4.count();
-
-        //qDebug() << "Normalize moran's I finished...";
+        computeMoranVectorAtCoordinates(dataMatrix, xCoordinates, yCoordinates, zCoordinates, moranVector);
     }
 
     void Moran::computeMoranVector(const DataMatrix& dataMatrix, const std::vector<float>& xPositions, const std::vector<float>& yPositions, const std::vector<float>& zPositions, std::vector<float>& moranVector)
     {
         // 3D cluster with mean position
-        qDebug() << "Compute moran's I started...";
-        std::vector<std::vector<float>> distanceMat = computeWeightMatrix(xPositions, yPositions, zPositions);
-        //qDebug() << "Compute distance matrix finished...";
-        //qDebug() << "distanceMat[0][0] " << distanceMat[0][0] << " distanceMat[0][1] " << distanceMat[0][1];
+        computeMoranVectorAtCoordinates(dataMatrix, xPositions, yPositions, zPositions, moranVector);
+    }
 
-        // compute weight-related parameters 
-        float W, S1, S2, S4, S5;
-        moranParameters(distanceMat, W, S1, S2, S4, S5);
+    void Moran::computeMoranVectorAtCoordinates(const DataMatrix& dataMatrix, const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates, std::vector<float>& moranVector)
+    {
+        qDebug() << "Compute moran's I started...";
 
         moranVector.clear();
         moranVector.resize(dataMatrix.cols());
 
-#pragma omp parallel for
-        for (int i = 0; i < dataMatrix.cols(); ++i)
-        {
-            auto col = dataMatrix.col(i);
-            std::vector<float> geneExpression;
-            geneExpression.assign(col.data(), col.data() + col.size());
-            std::vector<float> result = moranTest_C(geneExpression, distanceMat, W, S1, S2, S4, S5);
-
-            float moranI = result[0];
-            float expectedI = result[1];
-            float sd = result[2];
-            float zScore;
-            if (sd != 0)
-                zScore = (moranI - expectedI) / sd;
-            else
-                zScore = 0;
-
-            // Check if zScore is NaN   
-            if (std::isnan(zScore)) {
-                zScore = 0;
-                //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: nan";
+        // the weights only depend on the flooded positions, so changing e.g. the number of clusters reuses them
+        const size_t key = computeWeightKey(xCoordinates, yCoordinates, zCoordinates, _weightSettings);
+
+        // a matching hash is confirmed with the full key, so a collision cannot reuse the weights of other coordinates
+        const bool cacheMatches = _weightCache.valid && _weightCache.key == key && sameWeightSettings(_weightCache.settings, _weightSettings) &&
+            _weightCache.xCoordinates == xCoordinates && _weightCache.yCoordinates == yCoordinates && _weightCache.zCoordinates == zCoordinates;
+
+        if (!cacheMatches) {
+            WeightCache& cache = _weightCache;
+            cache = WeightCache();
+
+            // compute weight-related parameters 
+            if (_weightSettings.type == SpatialWeightType::ALL_PAIRS) {
+                // N x N weights, only feasible for small floods or cluster means
+                std::vector<std::vector<float>> distanceMat = zCoordinates.empty() ? computeWeightMatrix(xCoordinates, yCoordinates) : computeWeightMatrix(xCoordinates, yCoordinates, zCoordinates);
+                moranParameters(distanceMat, cache.W, cache.S1, cache.S2, cache.S4, cache.S5);
+
+                // moved row by row into one dense matrix for the blocked products
+                const int N = distanceMat.size();
+                cache.denseWeight.resize(N, N);
+                for (int i = 0; i < N; ++i) {
+                    cache.denseWeight.row(i) = Eigen::Map<const Eigen::RowVectorXf>(distanceMat[i].data(), N);
+                    std::vector<float>().swap(distanceMat[i]);
+                }
+            }
+            else {
+                // memory and time scale with the number of neighbours per point
+                cache.sparseWeight = computeSpatialWeights(xCoordinates, yCoordinates, zCoordinates, _weightSettings);
+                moranParameters(cache.sparseWeight, cache.W, cache.S1, cache.S2, cache.S4, cache.S5);
             }
 
-            //qDebug() << "Gene name: " << _enabledDimNames[i] << " Moran's I: " << result[0] << " sd: " << sd << " Z-score: " << zScore;
-            moranVector[i] = zScore;
+            cache.key = key;
+            cache.xCoordinates = xCoordinates;
+            cache.yCoordinates = yCoordinates;
+            cache.zCoordinates = zCoordinates;
+            cache.settings = _weightSettings;
+            cache.valid = true;
         }
-        qDebug() << "Compute moran's I finished...";
+        else {
+            qDebug() << "Moran's I: reusing the spatial weights of the same flood";
+        }
+
+        const WeightCache& cache = _weightCache;
+        if (_weightSettings.type == SpatialWeightType::ALL_PAIRS)
+            computeMoranZScores(dataMatrix, cache.denseWeight, cache.W, cache.S4, cache.S5, moranVector);
+        else
+            computeMoranZScores(dataMatrix, cache.sparseWeight, cache.W, cache.S4, cache.S5, moranVector);
 
-        // normalize the correlation vector to 0 to 1for plotting in the bar chart
-        //float minCorr = *std::min_element(moranVector.begin(), moranVector.end());
-        //float maxCorr = *std::max_element(moranVector.begin(), moranVector.end());
-        ////qDebug() << "minCorr: " << minCorr << " maxCorr: " << maxCorr;
-        //// output the index of min and max correlation
-        //int minIndex = std::distance(moranVector.begin(), std::min_element(moranVector.begin(), moranVector.end()));
-        //int maxIndex = std::distance(moranVector.begin(), std::max_element(moranVector.begin(), moranVector.end()));
-        ////qDebug() << "minIndex: " << minIndex << " maxIndex: " << maxIndex;
+        _permutationPValues.clear();
+        if (_permutationSettings.enabled) {
+            if (_weightSettings.type == SpatialWeightType::ALL_PAIRS)
+                computeMoranPermutationPValues(dataMatrix, cache.denseWeight, _permutationSettings, _permutationPValues);
+            else
+                computeMoranPermutationPValues(dataMatrix, cache.sparseWeight, _permutationSettings, _permutationPValues);
+        }
 
-        //for (int i = 0; i < moranVector.size(); ++i) {
-        //    moranVector[i] = (moranVector[i] - minCorr) / (maxCorr - minCorr);
-        //}
-        //qDebug() << "Normalize moran's I finished...";
+        qDebug() << "Compute moran's I finished...";
     }
 
-    void Diff::computeDiff(const DataMatrix& selectionDataMatrix, const DataMatrix& allDataMatrix, std::vector<float>& diffVector)
+    void Diff::computeDiff(const DataMatrixRef& selectionDataMatrix, const DataMatrixRef& allDataMatrix, std::vector<float>& diffVector)
     {
         // without normalization
         Eigen::VectorXf meanA = selectionDataMatrix.colwise().mean();
@@ -608,21 +758,40 @@ namespace corrFilter
         qDebug() << "meanB size: " << meanB.size() << " meanB min: " << meanB.minCoeff() << " meanB max: " << meanB.maxCoeff();
         qDebug() << "meanB[0] " << meanB[0] << " meanB[1] " << meanB[1] << " meanB[2] " << meanB[2];*/
 
-        // Norm to range [0, 1] for plotting in the bar chart
-        float minContrast = contrast.minCoeff();
-        float maxContrast = contrast.maxCoeff();
-        float rangeContrast = maxContrast - minContrast;
+        normalizeContrast(contrast, diffVector);
+    }
 
-        if (rangeContrast != 0) {
-            contrast = (contrast.array() - minContrast) / rangeContrast;
-        }
-        else {
-            contrast.setZero(); 
-        }
+    void Diff::computeDiff(const FloodMoments& selectionMoments, const GeneStats& allStats, std::vector<float>& diffVector)
+    {
+        Eigen::VectorXf contrast = selectionMoments.mean() - allStats.mean();
 
-        diffVector.clear();
-        diffVector.assign(contrast.data(), contrast.data() + contrast.size());
+        normalizeContrast(contrast, diffVector);
+    }
+
+    void Diff::computeRankDiff(const GeneRanks& ranks, const std::vector<int>& selectionIndices, std::vector<float>& diffVector)
+    {
+        const int numGenes = ranks.getNumGenes();
+        const double N = ranks.getNumPoints();
+
+        diffVector.assign(numGenes, 0.0f);
 
+        // the selection size is the number of points that were ranked, indices out of range are skipped by rankSums()
+        int numSelected = 0;
+        const Eigen::VectorXd rankSums = ranks.rankSums(selectionIndices, numSelected);
+        const Eigen::VectorXd& tieTerms = ranks.getTieTerms();
+
+        const double n1 = numSelected;
+        const double n2 = N - n1;
+        if (n1 == 0 || n2 <= 0)
+            return;
+
+#pragma omp parallel for
+        for (int c = 0; c < numGenes; ++c) {
+            const double U = rankSums[c] - n1 * (n1 + 1) / 2;
+            const double variance = n1 * n2 / 12 * ((N + 1) - tieTerms[c] / (N * (N - 1)));
+            const double z = (U - n1 * n2 / 2) / std::sqrt(variance);
+            diffVector[c] = std::isfinite(z) ? static_cast<float>(z) : 0.0f;
+        }
     }
 
 }
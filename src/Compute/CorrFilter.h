@@ -1,6 +1,9 @@
 #pragma once
 
 #include "DataMatrix.h"
+#include "GeneRanks.h"
+#include "GeneStats.h"
+#include "SpatialWeights.h"
 
 #include <vector>
 #include <QString>
@@ -13,7 +16,8 @@ namespace corrFilter
         SPATIALZ,//anterior-posterior in ABC Atlas
         SPATIALY,//dorsal-ventral in ABC Atlas
         DIFF,
-        MORAN
+        MORAN,
+        WILCOXON//rank-sum test of the selection against the rest
     };
 
     class SpatialCorr
@@ -21,18 +25,43 @@ namespace corrFilter
     public:       
         // 2D + 3D all flood indices + one dimension
         void computeCorrelationVectorOneDimension(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<float>& positionsOneDimension, std::vector<float>& corrVector) const;
+        // 2D + 3D all flood indices + one axis of the positions of the running moments of the flood, see DataSubset::updateFloodMoments()
+        void computeCorrelationVectorOneDimension(const FloodMoments& floodMoments, int axis, std::vector<float>& corrVector) const;
         // 3D cluster with mean position + one dimension
         void computeCorrelationVectorOneDimension(const DataMatrix& dataMatrix, std::vector<float>& positionsOneDimension, std::vector<float>& corrVector) const;
         
         // 3D cluster with mean position + one dimension + weighting for singlecell
         void computeCorrelationVectorOneDimension(const DataMatrix& dataMatrix, std::vector<float>& positionsOneDimension, const Eigen::VectorXf& weights, std::vector<float>& corrVector) const;
-    
+
+        /**
+         * Weighted correlation of every column of \p dataMatrix with every column of \p positions (one per axis), as genes x axes
+         * One product X^T [w * centered positions, w] gives the cross moments with all axes and the weighted sums of all genes,
+         * the norms are read from the columns in place, so all axes cost one pass and no copy of the data. Empty \p weights weight every row the same
+         */
+        void computeCorrelationMatrix(const DataMatrix& dataMatrix, const DataMatrix& positions, const Eigen::VectorXf& weights, Eigen::MatrixXf& correlations) const;
     };
 
     class Diff
     {
     public:
-        void computeDiff(const DataMatrix& selectionDataMatrix, const DataMatrix& allDataMatrix, std::vector<float>& diffVector);
+        void computeDiff(const DataMatrixRef& selectionDataMatrix, const DataMatrixRef& allDataMatrix, std::vector<float>& diffVector);
+        // the means of the selection are taken from the running moments of the flood, nothing is read
+        void computeDiff(const FloodMoments& selectionMoments, const GeneStats& allStats, std::vector<float>& diffVector);
+
+        /**
+         * Wilcoxon rank-sum (Mann-Whitney) test of the points \p selectionIndices against all other points, as tie-corrected z-scores per gene
+         * Positive if a gene is higher in the selection. Only the precomputed ranks of the selected points are summed, nothing is sorted
+         */
+        void computeRankDiff(const GeneRanks& ranks, const std::vector<int>& selectionIndices, std::vector<float>& diffVector);
+    };
+
+    // permutation test of Moran's I, in addition to the analytical z-scores
+    struct MoranPermutationSettings
+    {
+        bool            enabled = false;
+        int             maxPermutations = 999;
+        int             stopExceedances = 10;       // a gene stops once this many permutations were at least as extreme
+        unsigned int    seed = 1;
     };
 
     class Moran
@@ -42,13 +71,50 @@ namespace corrFilter
         std::vector<std::vector<float>> computeWeightMatrix(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates);
         std::vector<std::vector<float>> computeWeightMatrix(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates);// overload
         void moranParameters(const std::vector<std::vector<float>>& weight, float& W, float& S1, float& S2, float& S4, float& S5);
-        std::vector<float> moranTest_C(const std::vector<float>& x, std::vector<std::vector<float>>& weight, const float W, const float S1, const float S2, const float S4, const float S5);
+        // overloads for sparse neighbour weights, see computeSpatialWeights()
+        void moranParameters(const SpatialWeightMatrix& weight, float& W, float& S1, float& S2, float& S4, float& S5);
         // 2D
         void computeMoranVector(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<mv::Vector2f>& positions, std::vector<float>& moranVector);
         // 3D all flood indices
         void computeMoranVector(const std::vector<int>& floodIndices, const DataMatrix& dataMatrix, const std::vector<float>& xPositions, const std::vector<float>& yPositions, const std::vector<float>& zPositions, std::vector<float>& moranVector);
         // 3D cluster with mean position
         void computeMoranVector(const DataMatrix& dataMatrix, const std::vector<float>& xPositions, const std::vector<float>& yPositions, const std::vector<float>& zPositions, std::vector<float>& moranVector);
+
+        void setWeightSettings(const SpatialWeightSettings& settings) { _weightSettings = settings; }
+        const SpatialWeightSettings& getWeightSettings() const { return _weightSettings; }
+
+        /** Release the weights kept from the last computation, e.g. when the dataset changes */
+        void clearWeightCache() { _weightCache = WeightCache(); }
+
+        void setPermutationSettings(const MoranPermutationSettings& settings) { _permutationSettings = settings; }
+        const MoranPermutationSettings& getPermutationSettings() const { return _permutationSettings; }
+
+        /** Two-sided permutation p-values of the last computeMoranVector(), one per gene, empty if the permutation test is disabled */
+        const std::vector<float>& getPermutationPValues() const { return _permutationPValues; }
+
+    private:
+        // z-score of Moran's I of every column of dataMatrix, row i is the point at (xCoordinates[i], yCoordinates[i], zCoordinates[i]), zCoordinates is empty for 2D
+        void computeMoranVectorAtCoordinates(const DataMatrix& dataMatrix, const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates, std::vector<float>& moranVector);
+
+        // weights and their parameters of the last computation, reused while the flood, its positions and the weight settings stay the same
+        struct WeightCache
+        {
+            bool                    valid = false;
+            size_t                  key = 0;            // hash of the coordinates and the weight settings, rejects most changes without comparing the coordinates
+            std::vector<float>      xCoordinates;       // the full key, compared when the hashes match
+            std::vector<float>      yCoordinates;
+            std::vector<float>      zCoordinates;
+            SpatialWeightSettings   settings;
+            SpatialWeightMatrix     sparseWeight;       // all but all pairs
+            DataMatrix              denseWeight;        // all pairs
+            float                   W = 0, S1 = 0, S2 = 0, S4 = 0, S5 = 0;
+        };
+
+    private:
+        SpatialWeightSettings   _weightSettings;    // neighbours that are weighted, all pairs uses the dense weight matrix
+        WeightCache             _weightCache;
+        MoranPermutationSettings _permutationSettings;
+        std::vector<float>      _permutationPValues;
     };
 
     class CorrFilter
@@ -61,6 +127,8 @@ namespace corrFilter
         void computePairwiseCorrelationVector(const std::vector<QString>& dimNames, const std::vector<int>& dimIndices, const DataMatrix& dataMatrix, DataMatrix& corrMatrix) const;
         // for 3D cluster with mean position + weighting
         void computePairwiseCorrelationVector(const std::vector<QString>& dimNames, const std::vector<int>& dimIndices, const DataMatrix& dataMatrix, const Eigen::VectorXf& weights, DataMatrix& corrMatrix) const;
+        // sparse data with all points, only the rows in rowIndices are used
+        void computePairwiseCorrelationVector(const std::vector<int>& dimIndices, const SparseDataMatrix& dataMatrix, const std::vector<int>& rowIndices, DataMatrix& corrMatrix) const;
 
         // Non-const member functions
         SpatialCorr&         getSpatialCorrFilter()  { return _spatialCorr; }
@@ -0,0 +1,153 @@
+#include "DataCache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    template<typename T>
+    void addVector(QCryptographicHash& hash, const std::vector<T>& values)
+    {
+        const int64_t numValues = static_cast<int64_t>(values.size());
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(&numValues), sizeof(numValues)));
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(values.data()), static_cast<qsizetype>(values.size() * sizeof(T))));
+    }
+
+    // a 64-bit multiply-xor checksum of every value, much cheaper than hashing the values themselves
+    uint64_t checksumValues(const std::vector<float>& values)
+    {
+        uint64_t checksum = values.size();
+        for (float value : values)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            checksum = (checksum ^ bits) * 0x9E3779B97F4A7C15ull;
+            checksum ^= checksum >> 29;
+        }
+        return checksum;
+    }
+
+    // only this many evenly spaced dimensions are read, so the key stays cheap for any number of dimensions
+    constexpr int maxChecksumDimensions = 32;
+
+    void addSizes(QCryptographicHash& hash, mv::Dataset<Points> dataset)
+    {
+        const int64_t sizes[2] = { dataset->getNumPoints(), dataset->getNumDimensions() };
+        hash.addData(QByteArrayView(reinterpret_cast<const char*>(sizes), sizeof(sizes)));
+    }
+
+    void addDimensionChecksums(QCryptographicHash& hash, mv::Dataset<Points> dataset, const std::vector<int>& enabledDimensions)
+    {
+        const int numDims = static_cast<int>(enabledDimensions.size());
+        const int numSamples = std::min(numDims, maxChecksumDimensions);
+        std::vector<uint64_t> checksums(numSamples);
+
+#pragma omp parallel
+        {
+            std::vector<float> dimData;
+
+#pragma omp for
+            for (int s = 0; s < numSamples; s++)
+            {
+                dataset->extractDataForDimension(dimData, enabledDimensions[static_cast<int64_t>(s) * numDims / numSamples]);
+                checksums[s] = checksumValues(dimData);
+            }
+        }
+
+        addVector(hash, checksums);
+    }
+}
+
+bool DataCacheHeader::isCompatible(const DataCacheHeader& expected) const
+{
+    return std::memcmp(magic, expected.magic, sizeof(magic)) == 0 && version == expected.version &&
+        numRows == expected.numRows && numCols == expected.numCols &&
+        numProjRows == expected.numProjRows && numProjCols == expected.numProjCols;
+}
+
+QString computeDataCacheKey(mv::Dataset<Points> sourceDataset, mv::Dataset<Points> fullDataset, const std::vector<int>& enabledDimensions, const std::vector<int>& enabledProjDimensions, const PointSubset& subset)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    const uint32_t version = DataCacheHeader::currentVersion;
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(&version), sizeof(version)));
+
+    hash.addData(sourceDataset->getId().toUtf8());
+    hash.addData(fullDataset->getId().toUtf8());
+    addSizes(hash, sourceDataset);
+    addSizes(hash, fullDataset);
+
+    addVector(hash, enabledDimensions);
+    addVector(hash, enabledProjDimensions);
+    const uint8_t isFull = subset.isFull;
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(&isFull), sizeof(isFull)));
+    addVector(hash, subset.globalIndices);
+
+    addDimensionChecksums(hash, sourceDataset, enabledDimensions);
+    addDimensionChecksums(hash, fullDataset, enabledProjDimensions);
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString getDataCacheFilePath(const QString& key)
+{
+    QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/GeneSurfer");
+    cacheDir.mkpath(".");
+
+    return cacheDir.filePath(key + ".bin");
+}
+
+bool hasDataCacheFile(const QString& filePath, const DataCacheHeader& expected)
+{
+    QFile file(filePath);
+    if (!file.exists() || !file.open(QFile::ReadOnly))
+        return false;
+
+    DataCacheHeader header;
+    const qint64 numBytes = static_cast<qint64>(sizeof(header));
+    return file.read(reinterpret_cast<char*>(&header), numBytes) == numBytes && header.isCompatible(expected) && file.size() == header.fileSize();
+}
+
+void touchDataCacheFile(const QString& filePath)
+{
+    QFile file(filePath);
+    if (file.open(QFile::ReadWrite))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+}
+
+void removeDataCacheFile(const QString& filePath)
+{
+    if (filePath.isEmpty() || !QFile::exists(filePath))
+        return;
+
+    // a file that is mapped as out-of-core storage cannot be removed on every platform
+    if (!QFile::remove(filePath))
+        qDebug() << "WARNING: removeDataCacheFile(): could not remove outdated cache file " << filePath;
+}
+
+void pruneDataCache(int64_t maxBytes, const QString& keepFilePath)
+{
+    QDir cacheDir(QFileInfo(keepFilePath).absolutePath());
+
+    // most recently used first
+    const QFileInfoList files = cacheDir.entryInfoList({ "*.bin" }, QDir::Files, QDir::Time);
+
+    int64_t totalBytes = 0;
+    for (const QFileInfo& fileInfo : files)
+    {
+        totalBytes += fileInfo.size();
+        if (totalBytes <= maxBytes || fileInfo.absoluteFilePath() == QFileInfo(keepFilePath).absoluteFilePath())
+            continue;
+
+        if (QFile::remove(fileInfo.absoluteFilePath()))
+            totalBytes -= fileInfo.size();
+        else
+            qDebug() << "WARNING: pruneDataCache(): could not remove cache file " << fileInfo.absoluteFilePath();
+    }
+}
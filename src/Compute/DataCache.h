@@ -0,0 +1,61 @@
+#pragma once
+
+#include "DataMatrix.h"
+
+#include <QString>
+
+#include <cstdint>
+
+/**
+ * Header of a cached base data file
+ *
+ * The header is followed by the standardized base data and the full projection (both column-major),
+ * then the per-gene variances, zero levels and statistics (sum, sum of squares, min, max, non-zeros)
+ */
+struct DataCacheHeader
+{
+    static constexpr uint32_t currentVersion = 1;
+
+    char        magic[8] = { 'G', 'S', 'C', 'A', 'C', 'H', 'E', '\0' };
+    uint32_t    version = currentVersion;
+    int32_t     numStatsPoints = 0;
+    int64_t     numRows = 0;
+    int64_t     numCols = 0;
+    int64_t     numProjRows = 0;
+    int64_t     numProjCols = 0;
+
+    bool isCompatible(const DataCacheHeader& expected) const;
+
+    int64_t dataOffset() const { return sizeof(DataCacheHeader); }
+    int64_t projectionOffset() const { return dataOffset() + numRows * numCols * static_cast<int64_t>(sizeof(float)); }
+    int64_t geneDataOffset() const { return projectionOffset() + numProjRows * numProjCols * static_cast<int64_t>(sizeof(float)); }
+
+    /** Expected file size, variances, zero levels, sum, sum of squares, min and max are floats, the non-zeros are ints */
+    int64_t fileSize() const { return geneDataOffset() + numCols * static_cast<int64_t>(6 * sizeof(float) + sizeof(int32_t)); }
+};
+
+/** Total size of the cache files above which the least recently used ones are removed, see pruneDataCache() */
+constexpr int64_t maxDataCacheBytes = int64_t(20) << 30;
+
+/**
+ * Key of the cached base data of \p sourceDataset and the projection of \p fullDataset
+ * Hashes the dataset ids and sizes, the enabled dimensions, the subset rows and a checksum of all values of at most 32 evenly spaced
+ * enabled dimensions per dataset, so the key costs a small fraction of a pass over the data. An edit of an unsampled dimension
+ * does not change the key, the owner removes the cache file when the data changes, see removeDataCacheFile()
+ */
+QString computeDataCacheKey(mv::Dataset<Points> sourceDataset, mv::Dataset<Points> fullDataset, const std::vector<int>& enabledDimensions, const std::vector<int>& enabledProjDimensions, const PointSubset& subset);
+
+/** File of the cached base data with \p key in the user cache directory, the directory is created if needed */
+QString getDataCacheFilePath(const QString& key);
+
+/** Whether \p filePath exists and its header and size match \p expected, only the header is read */
+bool hasDataCacheFile(const QString& filePath, const DataCacheHeader& expected);
+
+/** Mark \p filePath as used, so it is removed last by pruneDataCache() */
+void touchDataCacheFile(const QString& filePath);
+
+/** Remove \p filePath, e.g. because the data it was computed from changed */
+void removeDataCacheFile(const QString& filePath);
+
+/** Remove the least recently used cache files until they take at most \p maxBytes, \p keepFilePath is never removed */
+void pruneDataCache(int64_t maxBytes, const QString& keepFilePath);
@@ -2,91 +2,219 @@
 
 #include "PointData/DimensionsPickerAction.h"
 
-void convertToEigenMatrix(mv::Dataset<Points> dataset, mv::Dataset<Points> sourceDataset, DataMatrix& dataMatrix)
+#include <algorithm>
+#include <numeric>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+std::vector<int> getEnabledDimensionIndices(mv::Dataset<Points> dataset)
 {
-    // Compute num points
-    std::vector<bool> enabledDims = sourceDataset->getDimensionsPickerAction().getEnabledDimensions();
-    int numPoints = sourceDataset->getNumPoints();
-    int numDimensions = sourceDataset->getNumDimensions();
+    std::vector<bool> enabledDims = dataset->getDimensionsPickerAction().getEnabledDimensions();
+    int numDimensions = dataset->getNumDimensions();
     int numEnabledDims = std::count(enabledDims.begin(), enabledDims.end(), true);
 
-    // Create list of enabled dimensions
     std::vector<int> enabledDimensions(numEnabledDims);
     int col = 0;
     for (int d = 0; d < numDimensions; d++)
         if (enabledDims[d])
             enabledDimensions[col++] = d;
 
-    DataMatrix fullDataMatrix;
-    fullDataMatrix.resize(numPoints, numEnabledDims);
+    return enabledDimensions;
+}
 
-#pragma omp parallel for
-    for (int d = 0; d < enabledDimensions.size(); d++)
-    {
-        int dim = enabledDimensions[d];
+PointSubset getPointSubset(mv::Dataset<Points> dataset)
+{
+    PointSubset subset;
+    subset.isFull = dataset->isFull();
+
+    // FIXME Might need to change this into getIndicesIntoFullDataset,
+    // because now it also goes down the subset chain of the non-derived data
+    if (!subset.isFull)
+        dataset->getGlobalIndices(subset.globalIndices);
 
+    return subset;
+}
+
+Eigen::Index getNumExtractedRows(mv::Dataset<Points> extractDataset, const PointSubset& subset)
+{
+    return subset.isFull ? static_cast<Eigen::Index>(extractDataset->getNumPoints()) : static_cast<Eigen::Index>(subset.globalIndices.size());
+}
+
+void extractEnabledDimensions(mv::Dataset<Points> extractDataset, const std::vector<int>& enabledDimensions, const PointSubset& subset, DataMatrixMap dataMatrix, const std::function<bool()>& nextColumn)
+{
+    const bool gatherRows = !subset.isFull;
+    const std::vector<uint32_t>& globalIndices = subset.globalIndices;
+    const int numRows = static_cast<int>(dataMatrix.rows());
+    const int numCols = static_cast<int>(enabledDimensions.size());
+
+#pragma omp parallel
+    {
+        // one scratch column per thread, reused for all dimensions of this thread
         std::vector<float> dimData;
-        sourceDataset->extractDataForDimension(dimData, dim);
-        for (int i = 0; i < numPoints; i++)
-            fullDataMatrix(i, d) = dimData[i];
+
+#pragma omp for
+        for (int d = 0; d < numCols; d++)
+        {
+            if (nextColumn && !nextColumn())
+                continue;
+
+            extractDataset->extractDataForDimension(dimData, enabledDimensions[d]);
+
+            float* dst = dataMatrix.col(d).data();
+            if (gatherRows)
+            {
+                for (int i = 0; i < numRows; i++)
+                    dst[i] = dimData[globalIndices[i]];
+            }
+            else
+                std::copy(dimData.begin(), dimData.begin() + numRows, dst);
+        }
     }
+}
+
+float estimateDensity(mv::Dataset<Points> extractDataset, const std::vector<int>& enabledDimensions, const PointSubset& subset, int maxSampledDimensions)
+{
+    const int numDims = static_cast<int>(enabledDimensions.size());
+    const int numSamples = std::min(numDims, maxSampledDimensions);
+    const Eigen::Index numRows = getNumExtractedRows(extractDataset, subset);
+
+    if (numSamples == 0 || numRows == 0)
+        return 1.0f;
+
+    int64_t numNonZeros = 0;
 
-    // If the dataset was a subset or subset chain, take only a portion of the matrix by indexing
-    if (!dataset->isFull())
+#pragma omp parallel reduction(+:numNonZeros)
     {
-        // FIXME Might need to change this into getIndicesIntoFullDataset,
-        // because now it also goes down the subset chain of the non-derived data
-        std::vector<uint32_t> indices;
-        dataset->getGlobalIndices(indices);
+        std::vector<float> dimData;
 
-        dataMatrix = fullDataMatrix(indices, Eigen::all);
+#pragma omp for
+        for (int s = 0; s < numSamples; s++)
+        {
+            extractDataset->extractDataForDimension(dimData, enabledDimensions[static_cast<int64_t>(s) * numDims / numSamples]);
+
+            if (subset.isFull)
+                numNonZeros += std::count_if(dimData.begin(), dimData.begin() + numRows, [](float v) { return v != 0.0f; });
+            else
+                for (uint32_t index : subset.globalIndices)
+                    numNonZeros += dimData[index] != 0.0f;
+        }
     }
-    else
-        dataMatrix = fullDataMatrix;
+
+    return static_cast<float>(static_cast<double>(numNonZeros) / (static_cast<double>(numRows) * numSamples));
 }
 
-void convertToEigenMatrixProjection(mv::Dataset<Points> dataset, DataMatrix& dataMatrix)
+namespace
 {
-    mv::Dataset<Points> fullDataset = dataset->getFullDataset<Points>();
+    // rows are prefetched this many gathered rows ahead, enough to cover the memory latency of a random read
+    constexpr int gatherPrefetchDistance = 16;
 
-    // Compute num points
-    std::vector<bool> enabledDims = dataset->getDimensionsPickerAction().getEnabledDimensions();
-    int numPoints = dataset->getNumPoints();
-    int numPointsOfFull = fullDataset->getNumPoints();
-    int numDimensions = dataset->getNumDimensions();
-    int numEnabledDims = std::count(enabledDims.begin(), enabledDims.end(), true);
+    inline void prefetchRead(const float* address)
+    {
+#if defined(_MSC_VER)
+        _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0);
+#else
+        __builtin_prefetch(address, 0, 3);
+#endif
+    }
+}
 
-    // Create list of enabled dimensions
-    std::vector<int> enabledDimensions(numEnabledDims);
-    int col = 0;
-    for (int d = 0; d < numDimensions; d++)
-        if (enabledDims[d])
-            enabledDimensions[col++] = d;
+void gatherDenseRows(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, DataMatrix& gatheredMatrix)
+{
+    std::vector<int> columns(dataMatrix.cols());
+    std::iota(columns.begin(), columns.end(), 0);
 
-    DataMatrix fullDataMatrix;
-    fullDataMatrix.resize(numPointsOfFull, numEnabledDims);
+    gatherDenseRows(dataMatrix, indices, columns, gatheredMatrix);
+}
 
-#pragma omp parallel for
-    for (int d = 0; d < numEnabledDims; d++)
+void gatherDenseRows(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& gatheredMatrix)
+{
+    const int numRows = static_cast<int>(indices.size());
+    const int numCols = static_cast<int>(columns.size());
+
+    gatheredMatrix.resize(numRows, numCols);
+
+    // Visit the source rows in ascending order, so every column is streamed front to back instead of read at random
+    // The order is computed once and shared by all columns
+    std::vector<int> order(numRows);
+    std::iota(order.begin(), order.end(), 0);
+    if (!std::is_sorted(indices.begin(), indices.end()))
+        std::sort(order.begin(), order.end(), [&indices](int a, int b) { return indices[a] < indices[b]; });
+
+    std::vector<int> sortedIndices(numRows);
+    for (int k = 0; k < numRows; k++)
+        sortedIndices[k] = indices[order[k]];
+
+    // static scheduling hands each thread one contiguous tile of columns
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < numCols; c++)
     {
-        int dim = enabledDimensions[d];
+        const float* src = dataMatrix.col(columns[c]).data();
+        float* dst = gatheredMatrix.col(c).data();
 
-        std::vector<float> dimData;
-        fullDataset->extractDataForDimension(dimData, dim);
-        for (int i = 0; i < numPointsOfFull; i++)
-            fullDataMatrix(i, d) = dimData[i];
+        for (int k = 0; k < numRows; k++)
+        {
+            if (k + gatherPrefetchDistance < numRows)
+                prefetchRead(src + sortedIndices[k + gatherPrefetchDistance]);
+
+            dst[order[k]] = src[sortedIndices[k]];
+        }
     }
+}
+
+void gatherSparseRows(const SparseDataMatrix& sparseMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, DataMatrix& denseMatrix)
+{
+    std::vector<int> columns(sparseMatrix.cols());
+    std::iota(columns.begin(), columns.end(), 0);
+
+    gatherSparseRows(sparseMatrix, offsets, indices, columns, denseMatrix);
+}
+
+void gatherSparseRows(const SparseDataMatrix& sparseMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& denseMatrix)
+{
+    const int numRows = static_cast<int>(indices.size());
+    const int numCols = static_cast<int>(columns.size());
+
+    // position of every base row in the gathered matrix, -1 if it is not gathered
+    std::vector<int> rowToSubset(sparseMatrix.rows(), -1);
+    for (int i = 0; i < numRows; i++)
+        rowToSubset[indices[i]] = i;
+
+    denseMatrix.resize(numRows, numCols);
 
-    // If the dataset was a subset or subset chain, take only a portion of the matrix by indexing
-    if (!dataset->isFull())
+#pragma omp parallel for
+    for (int c = 0; c < numCols; c++)
     {
-        // FIXME Might need to change this into getIndicesIntoFullDataset,
-        // because now it also goes down the subset chain of the non-derived data
-        std::vector<uint32_t> indices;
-        dataset->getGlobalIndices(indices);
+        denseMatrix.col(c).setConstant(-offsets[columns[c]]);
+
+        for (SparseDataMatrix::InnerIterator it(sparseMatrix, columns[c]); it; ++it)
+        {
+            int row = rowToSubset[it.index()];
+            if (row >= 0)
+                denseMatrix(row, c) += it.value();
+        }
+    }
+}
 
-        dataMatrix = fullDataMatrix(indices, Eigen::all);
+namespace
+{
+    void gatherEnabledDimensions(mv::Dataset<Points> extractDataset, const std::vector<int>& enabledDimensions, const PointSubset& subset, DataMatrix& dataMatrix)
+    {
+        dataMatrix.resize(getNumExtractedRows(extractDataset, subset), enabledDimensions.size());
+        extractEnabledDimensions(extractDataset, enabledDimensions, subset, DataMatrixMap(dataMatrix.data(), dataMatrix.rows(), dataMatrix.cols()));
     }
-    else
-        dataMatrix = fullDataMatrix;
+}
+
+void convertToEigenMatrix(mv::Dataset<Points> dataset, mv::Dataset<Points> sourceDataset, DataMatrix& dataMatrix)
+{
+    // Only the rows of the subset are copied, the full source matrix is never materialized
+    gatherEnabledDimensions(sourceDataset, getEnabledDimensionIndices(sourceDataset), getPointSubset(dataset), dataMatrix);
+}
+
+void convertToEigenMatrixProjection(mv::Dataset<Points> dataset, DataMatrix& dataMatrix)
+{
+    mv::Dataset<Points> fullDataset = dataset->getFullDataset<Points>();
+
+    gatherEnabledDimensions(fullDataset, getEnabledDimensionIndices(dataset), getPointSubset(dataset), dataMatrix);
 }
@@ -5,8 +5,56 @@
 
 #include <Eigen/Eigen>
 
+#include <functional>
+
 
 using DataMatrix = Eigen::Matrix<float, -1, -1, Eigen::ColMajor>;
+using DataMatrixMap = Eigen::Map<DataMatrix>;          // view over storage that is not owned by an Eigen matrix, e.g. mapped from disk
+using DataMatrixRef = Eigen::Ref<const DataMatrix>;    // read-only argument type that binds to DataMatrix and DataMatrixMap without copying
+using SparseDataMatrix = Eigen::SparseMatrix<float, Eigen::ColMajor, int>;  // compressed sparse columns, one column per dimension
+
+/** Create list of enabled dimensions of \p dataset */
+std::vector<int> getEnabledDimensionIndices(mv::Dataset<Points> dataset);
+
+/** Rows that are extracted from a points dataset, either all points or the global indices of a subset, which may be empty */
+struct PointSubset
+{
+    bool                    isFull = true;
+    std::vector<uint32_t>   globalIndices;      // only used if !isFull
+};
+
+/** Rows of \p dataset, the global indices of its points if it is a subset or subset chain */
+PointSubset getPointSubset(mv::Dataset<Points> dataset);
+
+/** Number of rows extracted from \p extractDataset, i.e. all points for a full \p subset, otherwise the number of its global indices */
+Eigen::Index getNumExtractedRows(mv::Dataset<Points> extractDataset, const PointSubset& subset);
+
+/**
+ * Extract \p enabledDimensions of \p extractDataset into the preallocated \p dataMatrix, only the rows in \p subset are copied
+ * If given, \p nextColumn is called before each column, returning false skips the column (used for cancellation)
+ */
+void extractEnabledDimensions(mv::Dataset<Points> extractDataset, const std::vector<int>& enabledDimensions, const PointSubset& subset, DataMatrixMap dataMatrix, const std::function<bool()>& nextColumn = {});
+
+/** Fraction of non-zero values in (at most \p maxSampledDimensions evenly spaced) \p enabledDimensions of \p extractDataset */
+float estimateDensity(mv::Dataset<Points> extractDataset, const std::vector<int>& enabledDimensions, const PointSubset& subset, int maxSampledDimensions = 32);
+
+/**
+ * Gather the rows \p indices of \p dataMatrix into \p gatheredMatrix, i.e. gatheredMatrix.row(i) = dataMatrix.row(indices[i])
+ * Works column by column, each source column is read in ascending row order with prefetching and each output column is written contiguously
+ */
+void gatherDenseRows(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, DataMatrix& gatheredMatrix);
+
+/** Gather the rows \p indices of only the \p columns of \p dataMatrix, i.e. gatheredMatrix(i, c) = dataMatrix(indices[i], columns[c]) */
+void gatherDenseRows(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& gatheredMatrix);
+
+/**
+ * Gather the rows \p indices of a sparse matrix into the dense \p denseMatrix
+ * The stored values are shifted by -\p offsets per column, so implicit zeros become -offsets
+ */
+void gatherSparseRows(const SparseDataMatrix& sparseMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, DataMatrix& denseMatrix);
+
+/** Gather the rows \p indices of only the \p columns of a sparse matrix, column c of \p denseMatrix is column columns[c] */
+void gatherSparseRows(const SparseDataMatrix& sparseMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& denseMatrix);
 
 void convertToEigenMatrix(mv::Dataset<Points> dataset, mv::Dataset<Points> sourceDataset, DataMatrix& dataMatrix);
 
@@ -0,0 +1,385 @@
+#include "DataStore.h"
+
+#include <QDebug>
+#include <QSaveFile>
+
+#include <atomic>
+
+namespace
+{
+    template<typename T>
+    bool readValues(QFile& file, T* values, int64_t count)
+    {
+        const qint64 numBytes = static_cast<qint64>(count * sizeof(T));
+        return file.read(reinterpret_cast<char*>(values), numBytes) == numBytes;
+    }
+
+    template<typename T>
+    bool writeValues(QFile& file, const T* values, int64_t count)
+    {
+        const qint64 numBytes = static_cast<qint64>(count * sizeof(T));
+        return file.write(reinterpret_cast<const char*>(values), numBytes) == numBytes;
+    }
+}
+
+DataMatrixMap DataStorage::allocateStorage(DataMatrix& owned, MappedMatrix& mapped, Eigen::Index rows, Eigen::Index cols)
+{
+    if (_outOfCore && mapped.allocate(rows, cols))
+    {
+        owned.resize(0, 0);
+        return mapped.getMap();
+    }
+
+    // fall back to RAM if out-of-core storage is disabled or could not be created
+    mapped.release();
+    owned.resize(rows, cols);
+    return mapStorage(owned);
+}
+
+IngestionSource DataStorage::prepareIngestion(mv::Dataset<Points> dataset, mv::Dataset<Points> sourceDataset) const
+{
+    IngestionSource source;
+
+    mv::Dataset<Points> fullDataset = dataset->getFullDataset<Points>();
+
+    const std::vector<int> enabledDimensions = getEnabledDimensionIndices(sourceDataset);
+    const std::vector<int> enabledProjDimensions = getEnabledDimensionIndices(dataset);
+    const PointSubset subset = getPointSubset(dataset);
+
+    source.sizes.numRows = getNumExtractedRows(sourceDataset, subset);
+    source.sizes.numCols = enabledDimensions.size();
+    source.sizes.numProjRows = getNumExtractedRows(fullDataset, subset);
+    source.sizes.numProjCols = enabledProjDimensions.size();
+
+    source.density = estimateDensity(sourceDataset, enabledDimensions, subset);
+
+    // The base data and the projection only share their columns when both are read from the same points with the same enabled dimensions
+    source.sharedColumns = sourceDataset->getId() == fullDataset->getId() && enabledDimensions == enabledProjDimensions;
+
+    // Only the dense float data is cached, it is the most expensive to recompute and the only one that can be mapped back in as is
+    if (_useCache && source.density >= sparseDensityThreshold && _quantization == QuantizationType::NONE)
+    {
+        source.cacheFilePath = getDataCacheFilePath(computeDataCacheKey(sourceDataset, fullDataset, enabledDimensions, enabledProjDimensions, subset));
+
+        source.fromCache = hasDataCacheFile(source.cacheFilePath, source.sizes);
+        if (source.fromCache)
+            return source;
+    }
+
+    source.rawData.resize(source.sizes.numRows, source.sizes.numCols);
+    extractEnabledDimensions(sourceDataset, enabledDimensions, subset, mapStorage(source.rawData));
+
+    if (!source.sharedColumns)
+    {
+        source.rawProjection.resize(source.sizes.numProjRows, source.sizes.numProjCols);
+        extractEnabledDimensions(fullDataset, enabledProjDimensions, subset, mapStorage(source.rawProjection));
+    }
+
+    return source;
+}
+
+bool DataStorage::ingestData(IngestionSource& source, const IngestProgress& progress)
+{
+    // Release the previous base data before allocating the new one
+    _isFullView = true;
+    _dataMapped.release();
+    _fullProjMapped.release();
+    _sparseDataMatrix = SparseDataMatrix();
+    _sparseOffsets.resize(0);
+    _quantizedData.release();
+    _normalizedDataMatrix.resize(0, 0);
+
+    const Eigen::Index numRows = source.sizes.numRows;
+    const Eigen::Index numCols = source.sizes.numCols;
+
+    _isSparse = source.density < sparseDensityThreshold;
+    qDebug() << "DataStorage::ingestData(): density " << source.density << (_isSparse ? ", sparse storage" : ", dense storage");
+
+    _baseRanks.clear();
+    _cacheFilePath = source.cacheFilePath;
+
+    if (source.fromCache)
+    {
+        if (readCache(_cacheFilePath, source.sizes))
+        {
+            qDebug() << "DataStorage::ingestData(): loaded from cache " << _cacheFilePath;
+            touchDataCacheFile(_cacheFilePath);
+
+            // normalizing is invariant to standardizing, so the cached data gives the same result
+            if (_normalizeData)
+                normalizeDataEigen(getBaseData(), _normalizedDataMatrix);
+            return true;
+        }
+
+        // the raw values were not copied for a cache hit, so the data has to be prepared again without the cache
+        qDebug() << "WARNING: DataStorage::ingestData(): could not read cache file " << _cacheFilePath;
+        removeDataCacheFile(_cacheFilePath);
+        _cacheFilePath.clear();
+        return false;
+    }
+
+    DataMatrixMap fullProjection = allocateStorage(_fullProjMatrix, _fullProjMapped, source.sizes.numProjRows, source.sizes.numProjCols);
+    _variances.resize(numCols);
+    _zeroLevels.setZero(numCols);
+    _baseStats.resize(numCols, numRows);
+
+    if (_normalizeData && !_isSparse)
+        _normalizedDataMatrix.resize(numRows, numCols);
+    auto normalizedColumn = [this](int d) { return _normalizedDataMatrix.size() > 0 ? _normalizedDataMatrix.col(d).data() : nullptr; };
+
+    // Every column counts as one step, the loops skip the remaining columns once cancelled
+    const int numSteps = static_cast<int>(numCols + (source.sharedColumns ? 0 : source.sizes.numProjCols));
+    std::atomic<int> numStepsDone = 0;
+    std::atomic<bool> cancelled = false;
+
+    const std::function<bool()> nextColumn = [&]() -> bool {
+        if (cancelled)
+            return false;
+        if (progress && !progress(numStepsDone++, numSteps))
+            cancelled = true;
+        return !cancelled;
+    };
+
+    if (!source.sharedColumns)
+    {
+#pragma omp parallel for
+        for (int d = 0; d < static_cast<int>(source.rawProjection.cols()); d++)
+        {
+            if (!nextColumn())
+                continue;
+
+            std::copy(source.rawProjection.col(d).data(), source.rawProjection.col(d).data() + source.rawProjection.rows(), fullProjection.col(d).data());
+        }
+
+        source.rawProjection.resize(0, 0);
+    }
+
+    DataMatrixMap* sharedProjection = source.sharedColumns ? &fullProjection : nullptr;
+
+    if (_isSparse)
+    {
+        _dataMatrix.resize(0, 0);
+
+        ingestSparseData(source.rawData, sharedProjection, nextColumn);
+        source.rawData.resize(0, 0);
+        if (cancelled)
+            return false;
+
+        _zeroLevels = -_sparseOffsets;
+        _baseStats = computeGeneStats(_sparseDataMatrix, _sparseOffsets, {});
+        return true;
+    }
+
+    if (_quantization != QuantizationType::NONE)
+    {
+        _dataMatrix.resize(0, 0);
+
+        ingestQuantizedData(source.rawData, sharedProjection, nextColumn, _normalizeData ? &_normalizedDataMatrix : nullptr);
+        source.rawData.resize(0, 0);
+        return !cancelled;
+    }
+
+    // In RAM the raw values become the base data and are standardized in place, out-of-core they are standardized into the mapped file
+    DataMatrixMap baseData = _outOfCore ? allocateStorage(_dataMatrix, _dataMapped, numRows, numCols) : adoptStorage(_dataMatrix, std::move(source.rawData));
+    const bool inPlace = source.rawData.size() == 0;
+
+#pragma omp parallel for
+    for (int d = 0; d < static_cast<int>(numCols); d++)
+    {
+        if (!nextColumn())
+            continue;
+
+        const float* rawColumn = inPlace ? baseData.col(d).data() : source.rawData.col(d).data();
+        if (sharedProjection != nullptr)
+            std::copy(rawColumn, rawColumn + numRows, fullProjection.col(d).data());
+
+        // standardize and summarize while the raw column is still in cache
+        float* column = baseData.col(d).data();
+        _variances[d] = standardizeColumn(rawColumn, column, numRows, &_zeroLevels[d], normalizedColumn(d));
+        _baseStats.setColumn(d, column, _zeroLevels[d]);
+    }
+
+    source.rawData.resize(0, 0);
+    if (cancelled)
+        return false;
+
+    if (!_cacheFilePath.isEmpty())
+        writeCache(_cacheFilePath);
+
+    return true;
+}
+
+void DataStorage::ingestSparseData(const DataMatrix& rawData, DataMatrixMap* fullProjection, const std::function<bool()>& nextColumn)
+{
+    const int numRows = static_cast<int>(rawData.rows());
+    const int numCols = static_cast<int>(rawData.cols());
+
+    // The number of non-zeros is only known after reading the column, so they are collected per column first
+    std::vector<std::vector<int>> columnRows(numCols);
+    std::vector<std::vector<float>> columnValues(numCols);
+    _sparseOffsets.resize(numCols);
+
+#pragma omp parallel for
+    for (int d = 0; d < numCols; d++)
+    {
+        if (!nextColumn())
+            continue;
+
+        const float* rawColumn = rawData.col(d).data();
+
+        if (fullProjection != nullptr)
+            std::copy(rawColumn, rawColumn + numRows, fullProjection->col(d).data());
+
+        ColumnMoments moments = computeColumnMoments(rawColumn, numRows);
+        _variances[d] = moments.variance;
+
+        // same as standardizeColumn(): columns without variance keep their raw values
+        float invStddev = moments.variance > 0 ? 1.0f / std::sqrt(moments.variance) : 1.0f;
+        _sparseOffsets[d] = moments.variance > 0 ? moments.mean * invStddev : 0.0f;
+
+        for (int i = 0; i < numRows; i++)
+        {
+            if (rawColumn[i] != 0.0f)
+            {
+                columnRows[d].push_back(i);
+                columnValues[d].push_back(rawColumn[i] * invStddev);
+            }
+        }
+    }
+
+    // Fill the compressed column storage directly
+    _sparseDataMatrix.resize(numRows, numCols);
+    int* outerIndex = _sparseDataMatrix.outerIndexPtr();
+    outerIndex[0] = 0;
+    for (int d = 0; d < numCols; d++)
+        outerIndex[d + 1] = outerIndex[d] + static_cast<int>(columnRows[d].size());
+    _sparseDataMatrix.resizeNonZeros(outerIndex[numCols]);
+
+#pragma omp parallel for
+    for (int d = 0; d < numCols; d++)
+    {
+        std::copy(columnRows[d].begin(), columnRows[d].end(), _sparseDataMatrix.innerIndexPtr() + outerIndex[d]);
+        std::copy(columnValues[d].begin(), columnValues[d].end(), _sparseDataMatrix.valuePtr() + outerIndex[d]);
+
+        std::vector<int>().swap(columnRows[d]);
+        std::vector<float>().swap(columnValues[d]);
+    }
+}
+
+void DataStorage::ingestQuantizedData(const DataMatrix& rawData, DataMatrixMap* fullProjection, const std::function<bool()>& nextColumn, DataMatrix* normalizedData)
+{
+    const int numRows = static_cast<int>(rawData.rows());
+    const int numCols = static_cast<int>(rawData.cols());
+
+    _quantizedData.resize(_quantization, numRows, numCols);
+
+#pragma omp parallel
+    {
+        // the full precision standardized column only ever exists once per thread
+        std::vector<float> standardizedColumn(numRows);
+
+#pragma omp for
+        for (int d = 0; d < numCols; d++)
+        {
+            if (!nextColumn())
+                continue;
+
+            const float* rawColumn = rawData.col(d).data();
+
+            if (fullProjection != nullptr)
+                std::copy(rawColumn, rawColumn + numRows, fullProjection->col(d).data());
+
+            _variances[d] = standardizeColumn(rawColumn, standardizedColumn.data(), numRows, &_zeroLevels[d], normalizedData != nullptr ? normalizedData->col(d).data() : nullptr);
+            _baseStats.setColumn(d, standardizedColumn.data(), _zeroLevels[d]);
+            _quantizedData.encodeColumn(d, standardizedColumn.data());
+        }
+    }
+}
+
+bool DataStorage::readCache(const QString& filePath, const DataCacheHeader& expected)
+{
+    QFile file(filePath);
+    if (!file.exists() || !file.open(QFile::ReadOnly))
+        return false;
+
+    DataCacheHeader header;
+    if (!readValues(file, &header, 1) || !header.isCompatible(expected) || file.size() != header.fileSize())
+    {
+        qDebug() << "DataStorage::readCache(): ignoring incompatible cache file " << filePath;
+        return false;
+    }
+
+    const int numCols = static_cast<int>(header.numCols);
+
+    if (_outOfCore)
+    {
+        // the cache file is the backing file, only the pages that are used are read
+        _dataMatrix.resize(0, 0);
+        _fullProjMatrix.resize(0, 0);
+
+        if (!_dataMapped.mapFile(filePath, header.dataOffset(), header.numRows, header.numCols) ||
+            !_fullProjMapped.mapFile(filePath, header.projectionOffset(), header.numProjRows, header.numProjCols))
+        {
+            _dataMapped.release();
+            _fullProjMapped.release();
+            return false;
+        }
+    }
+    else
+    {
+        _dataMatrix.resize(header.numRows, header.numCols);
+        _fullProjMatrix.resize(header.numProjRows, header.numProjCols);
+
+        if (!readValues(file, _dataMatrix.data(), _dataMatrix.size()) || !readValues(file, _fullProjMatrix.data(), _fullProjMatrix.size()))
+            return false;
+    }
+
+    _variances.resize(numCols);
+    _zeroLevels.resize(numCols);
+    _baseStats.resize(numCols, header.numStatsPoints);
+
+    return file.seek(header.geneDataOffset()) &&
+        readValues(file, _variances.data(), numCols) &&
+        readValues(file, _zeroLevels.data(), numCols) &&
+        readValues(file, _baseStats.sum.data(), numCols) &&
+        readValues(file, _baseStats.sumSquares.data(), numCols) &&
+        readValues(file, _baseStats.min.data(), numCols) &&
+        readValues(file, _baseStats.max.data(), numCols) &&
+        readValues(file, _baseStats.numNonZeros.data(), numCols);
+}
+
+void DataStorage::writeCache(const QString& filePath)
+{
+    DataMatrixMap baseData = getBaseData();
+    DataMatrixMap fullProjection = getBaseFullProjection();
+    const int numCols = static_cast<int>(baseData.cols());
+
+    DataCacheHeader header;
+    header.numStatsPoints = _baseStats.numPoints;
+    header.numRows = baseData.rows();
+    header.numCols = baseData.cols();
+    header.numProjRows = fullProjection.rows();
+    header.numProjCols = fullProjection.cols();
+
+    // QSaveFile only replaces the cache file once everything is written, a cancelled or failed write never leaves a partial file
+    QSaveFile file(filePath);
+    bool written = file.open(QFile::WriteOnly) &&
+        writeValues(file, &header, 1) &&
+        writeValues(file, baseData.data(), baseData.size()) &&
+        writeValues(file, fullProjection.data(), fullProjection.size()) &&
+        writeValues(file, _variances.data(), numCols) &&
+        writeValues(file, _zeroLevels.data(), numCols) &&
+        writeValues(file, _baseStats.sum.data(), numCols) &&
+        writeValues(file, _baseStats.sumSquares.data(), numCols) &&
+        writeValues(file, _baseStats.min.data(), numCols) &&
+        writeValues(file, _baseStats.max.data(), numCols) &&
+        writeValues(file, _baseStats.numNonZeros.data(), numCols);
+
+    if (!written || !file.commit())
+    {
+        qDebug() << "WARNING: DataStorage::writeCache(): could not write cache file " << filePath;
+        return;
+    }
+
+    pruneDataCache(maxDataCacheBytes, filePath);
+}
@@ -1,41 +1,146 @@
 #pragma once
 
+#include "DataCache.h"
 #include "DataMatrix.h"
 #include "DataTransformations.h"
+#include "GeneRanks.h"
+#include "GeneStats.h"
+#include "MappedMatrix.h"
+#include "QuantizedMatrix.h"
+
+#include <numeric>
+
+/**
+ * Everything DataStorage::ingestData() reads from the datasets, copied by DataStorage::prepareIngestion() on the GUI thread,
+ * so the ingestion itself only works on plain data and can run in the background
+ */
+struct IngestionSource
+{
+    DataCacheHeader     sizes;                  // rows and columns of the base data and the projection
+    DataMatrix          rawData;                // raw enabled dimensions of the source dataset, only the subset rows
+    DataMatrix          rawProjection;          // raw enabled dimensions of the full dataset, empty if it shares the columns of rawData
+    bool                sharedColumns = false;
+    float               density = 1.0f;         // estimated fraction of non-zero values, see estimateDensity()
+    QString             cacheFilePath;          // cache file of the base data, empty if it is not cached
+    bool                fromCache = false;      // a compatible cache file exists, so the raw data was not copied
+};
 
-// Eigen::IndexedView<Eigen::MatrixXf, std::vector<int>, Eigen::internal::AllRange<-1>>
+using ViewIndices = Eigen::Map<const Eigen::VectorXi>;    // non-owning index list, cheap to copy into an IndexedView
+using DataView = Eigen::IndexedView<DataMatrixMap, ViewIndices, Eigen::internal::AllRange<-1>>;
 
 class DataStorage
 {
 public:
+    /** Fraction of non-zero expression values below which the base data is stored sparse */
+    static constexpr float sparseDensityThreshold = 0.3f;
+
     // Base getters
-    DataMatrix& getBaseData() { return _dataMatrix; }
-    DataMatrix& getBaseFullProjection() { return _fullProjMatrix; }
+    DataMatrixMap getBaseData() { return mapStorage(_dataMatrix, _dataMapped); }
+    DataMatrixMap getBaseFullProjection() { return mapStorage(_fullProjMatrix, _fullProjMapped); }
     DataMatrix& getBaseNormalizedData() { return _normalizedDataMatrix;  }
+    const SparseDataMatrix& getBaseSparseData() const { return _sparseDataMatrix; }
+    const Eigen::VectorXf& getBaseSparseOffsets() const { return _sparseOffsets; }
+    const QuantizedMatrix& getBaseQuantizedData() const { return _quantizedData; }
     bool hasData() { return _hasBaseData; }
 
-    // View getters
-    DataMatrix& getDataView() { return _dataView; }
-    DataMatrix& getFullProjectionView() { return _fullProjectionView; }
+    // View getters - views are index lists over the base storage, nothing is copied
+    // The base data is not exposed as a view since it may be sparse or quantized, the kernels take getViewIndices() directly
+    DataView getFullProjectionView() { return getBaseFullProjection()(getViewIndexMap(), Eigen::all); }
     DataMatrix& getProjectionView() { return _projectionView; }
 
     const std::vector<int>& getViewIndices() const { return _viewIndices; }
+    bool isFullView() const { return _isFullView; }
 
     // Auxilliary data getters
     std::vector<float>& getVariances() { return _variances; }
 
-    int getNumPoints() { return _dataView.rows(); }
-    int getNumDimensions() { return _dataView.cols(); }
+    /** Standardized value of a raw zero per gene */
+    const Eigen::VectorXf& getZeroLevels() const { return _zeroLevels; }
+
+    /** Per-gene statistics of all points, computed during ingestData() */
+    const GeneStats& getBaseStats() const { return _baseStats; }
+
+    /** Mid-ranks of every gene over all points, only valid once computed, see computeBaseRanks() */
+    const GeneRanks& getBaseRanks() const { return _baseRanks; }
+    bool hasBaseRanks() const { return _baseRanks.isValid(); }
+
+    /**
+     * Rank the base data into \p ranks, only the rank filter needs them so they are not computed by ingestData()
+     * Only reads the base data, so it can run in the background as long as the storage is kept. For dense data the ranks
+     * take up to twice the memory of the base data, see GeneRanks
+     * @param nextColumn Optional cancellation, called before each column
+     * @return false if the ranking was cancelled
+     */
+    bool computeBaseRanks(GeneRanks& ranks, const std::function<bool()>& nextColumn = {})
+    {
+        if (_isSparse)
+            return ranks.compute(_sparseDataMatrix, nextColumn);
+        if (isQuantized())
+            return ranks.compute(_quantizedData, _zeroLevels, nextColumn);
+        return ranks.compute(getBaseData(), _zeroLevels, nextColumn);
+    }
+
+    void setBaseRanks(GeneRanks&& ranks) { _baseRanks = std::move(ranks); }
+
+    int getNumPoints() { return _viewIndices.size(); }
+    int getNumBasePoints() { return _isSparse ? _sparseDataMatrix.rows() : isQuantized() ? _quantizedData.rows() : getBaseData().rows(); }
+    int getNumDimensions() { return _isSparse ? _sparseDataMatrix.cols() : isQuantized() ? _quantizedData.cols() : getBaseData().cols(); }
+
+    /** Called with the number of ingested columns and the total, returning false cancels the ingestion; may be called from several threads */
+    using IngestProgress = std::function<bool(int numDone, int numTotal)>;
+
+    /**
+     * Copy everything ingestData() needs from \p dataset and \p sourceDataset, has to be called on the GUI thread
+     * The raw values of the enabled dimensions are copied unless the base data is loaded from the cache, so while ingesting
+     * the data takes its size once more in RAM, also for out-of-core, sparse and quantized storage
+     * @param dataset Points dataset for point position
+     * @param sourceDataset Source of \p dataset holding the expression data
+     */
+    IngestionSource prepareIngestion(mv::Dataset<Points> dataset, mv::Dataset<Points> sourceDataset) const;
+
+    /**
+     * Load the base data and the full projection from \p source, does not touch any dataset so it can run in the background
+     * Each raw column is read once and written both as raw projection and as standardized base column
+     * The base data is stored sparse if the estimated density is below sparseDensityThreshold,
+     * otherwise quantized if a quantization was set, otherwise as dense floats. The raw data of \p source is consumed
+     * @param progress Optional progress report and cancellation
+     * @return false if the ingestion was cancelled or the expected cache file could not be read, the storage is incomplete in that case
+     */
+    bool ingestData(IngestionSource& source, const IngestProgress& progress = {});
+
+    /** Keep the dense base matrices in memory-mapped files instead of RAM, takes effect on the next ingestData() */
+    void setOutOfCore(bool outOfCore) { _outOfCore = outOfCore; }
+    bool isOutOfCore() const { return _dataMapped.isValid(); }
+
+    /**
+     * Keep the standardized dense base data in the user cache directory and load it from there when the same data is ingested again,
+     * takes effect on the next ingestData(). Sparse and quantized storage is always computed
+     */
+    void setCacheEnabled(bool useCache) { _useCache = useCache; }
+
+    /** Cache file of the base data loaded by the last ingestData(), empty if it was not cached */
+    const QString& getCacheFilePath() const { return _cacheFilePath; }
+
+    /** Also keep the min-max normalized base data, see getBaseNormalizedData(), computed by the standardization kernel; takes effect on the next ingestData() */
+    void setNormalizeData(bool normalizeData) { _normalizeData = normalizeData; }
+
+    /** Whether the base data is stored as sparse columns, see getBaseSparseData() */
+    bool isSparse() const { return _isSparse; }
+
+    /** Store dense base data with reduced precision, takes effect on the next ingestData() */
+    void setQuantization(QuantizationType quantization) { _quantization = quantization; }
+
+    /** Whether the base data is stored quantized, see getBaseQuantizedData() */
+    bool isQuantized() const { return _quantizedData.isValid(); }
 
     void setProjectionSize(float projectionSize) { _projectionSize = projectionSize; }
     float getProjectionSize() { return _projectionSize; }
 
     void createDataView()
     {
-        _dataView = _dataMatrix;
-        _fullProjectionView = _fullProjMatrix;
+        _isFullView = true;
 
-        _viewIndices.resize(_projectionView.rows());
+        _viewIndices.resize(getNumBasePoints());
         std::iota(_viewIndices.begin(), _viewIndices.end(), 0);
 
         _hasBaseData = true;
@@ -43,35 +148,84 @@ public:
 
     void createDataView(const std::vector<int>& indices)
     {
-        _dataView = _dataMatrix(indices, Eigen::all);
-        _fullProjectionView = _fullProjMatrix(indices, Eigen::all);
-
-        _viewIndices = indices;
+        // reuses the capacity of the previous view, so changing slices does not allocate
+        _viewIndices.assign(indices.begin(), indices.end());
+        _isFullView = false;
     }
 
+    /** The projection view is the only view that is materialized, it only holds the two displayed dimensions */
     void createProjectionView(int xDim, int yDim)
     {
-        getProjectionView() = getFullProjectionView()(Eigen::all, std::vector<int> { xDim, yDim });
+        DataMatrixMap fullProjection = getBaseFullProjection();
+        const int numPoints = _viewIndices.size();
+
+        _projectionView.resize(numPoints, 2);
+
+#pragma omp parallel for
+        for (int i = 0; i < numPoints; i++)
+        {
+            _projectionView(i, 0) = fullProjection(_viewIndices[i], xDim);
+            _projectionView(i, 1) = fullProjection(_viewIndices[i], yDim);
+        }
     }
 
+private:
+    /** Allocate \p rows x \p cols either in the mapped file or in RAM, depending on _outOfCore */
+    DataMatrixMap allocateStorage(DataMatrix& owned, MappedMatrix& mapped, Eigen::Index rows, Eigen::Index cols);
+
+    /** Store the standardized columns of \p rawData as sparse columns of raw / stddev with per-column offsets mean / stddev */
+    void ingestSparseData(const DataMatrix& rawData, DataMatrixMap* fullProjection, const std::function<bool()>& nextColumn);
+
+    ViewIndices getViewIndexMap() const { return ViewIndices(_viewIndices.data(), _viewIndices.size()); }
+
+    /** Store the standardized columns of \p rawData quantized as set by setQuantization(), and min-max normalized into \p normalizedData if given */
+    void ingestQuantizedData(const DataMatrix& rawData, DataMatrixMap* fullProjection, const std::function<bool()>& nextColumn, DataMatrix* normalizedData);
+
+    /** Load the dense base data and the per-gene data from \p filePath, or map it if out-of-core, returns false if there is no matching cache file */
+    bool readCache(const QString& filePath, const DataCacheHeader& expected);
+
+    /** Store the dense base data and the per-gene data in \p filePath */
+    void writeCache(const QString& filePath);
+
+    static DataMatrixMap mapStorage(DataMatrix& owned) { return DataMatrixMap(owned.data(), owned.rows(), owned.cols()); }
+    static DataMatrixMap adoptStorage(DataMatrix& owned, DataMatrix&& values) { owned = std::move(values); return mapStorage(owned); }
+    static DataMatrixMap mapStorage(DataMatrix& owned, MappedMatrix& mapped) { return mapped.isValid() ? mapped.getMap() : mapStorage(owned); }
+
 private:
     // Stored state
-    // Base Data
+    // Base Data - either owned in RAM or mapped from disk
     DataMatrix                      _dataMatrix;
     DataMatrix                      _fullProjMatrix;
+    MappedMatrix                    _dataMapped;
+    MappedMatrix                    _fullProjMapped;
+    bool                            _outOfCore = false;
+    bool                            _useCache = false;
+    QString                         _cacheFilePath;
+
+    // Sparse base data - standardized value is _sparseDataMatrix(i, j) - _sparseOffsets[j]
+    SparseDataMatrix                _sparseDataMatrix;
+    Eigen::VectorXf                 _sparseOffsets;
+    bool                            _isSparse = false;
+
+    // Quantized base data
+    QuantizedMatrix                 _quantizedData;
+    QuantizationType                _quantization = QuantizationType::NONE;
     float                           _projectionSize = 0;
 
-    // normalized base data
+    // normalized base data, not kept for sparse base data
     DataMatrix                      _normalizedDataMatrix;
+    bool                            _normalizeData = false;
 
-    // View
-    DataMatrix                      _dataView;
-    DataMatrix                      _fullProjectionView;
+    // View - indices into the base data, only the projection is materialized
     DataMatrix                      _projectionView;
+    bool                            _isFullView = true;
 
     std::vector<int>                _viewIndices;
 
     // Auxilliary data
     std::vector<float>              _variances;
+    Eigen::VectorXf                 _zeroLevels;
+    GeneStats                       _baseStats;
+    GeneRanks                       _baseRanks;
     bool                            _hasBaseData = false;
 };
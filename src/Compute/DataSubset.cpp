@@ -1,8 +1,9 @@
 #include "DataSubset.h"
 
-#include <set>
+#include <algorithm>
+#include <cmath>
 
-void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex)
+void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex)
 {   // for 2D data
     if (!floodFillDataset.isValid())
     {
@@ -17,7 +18,7 @@ void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int
 
 }
 
-void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, const std::vector<int>& onSliceIndices, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
+void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
 {   // for 3D data
     if (!floodFillDataset.isValid())
     {
@@ -31,7 +32,7 @@ void DataSubset::updateFloodFill(mv::Dataset<Points> floodFillDataset, const int
 
     updateIsFloodIndex(numPoints, floodIndices, isFloodIndex);// updates isFloodIndex
 
-    updateFloodFillOnSlice(isFloodIndex, floodIndices, onSliceIndices, isFloodOnSlice, onSliceFloodIndices);// updates slice subset for 3D data
+    updateFloodFillOnSlice(isFloodIndex, floodIndices, onSliceIndices, onSliceMask, isFloodOnSlice, onSliceFloodIndices);// updates slice subset for 3D data
 
 }
 
@@ -43,6 +44,7 @@ void DataSubset::processFloodFillDataset(mv::Dataset<Points> floodFillDataset, s
     //qDebug() << "DataSubset::processFloodFillDataset(): floodNodesWave size: " << floodNodesWave.size();
 
     // process the selected flood-fill 
+    _waveAggregates = WaveAggregates();
     floodIndices.clear();
     waveNumbers.clear();
     int tempWave = 0;
@@ -65,139 +67,400 @@ void DataSubset::processFloodFillDataset(mv::Dataset<Points> floodFillDataset, s
     }
 }
 
-void DataSubset::updateIsFloodIndex(const int numPoints, const std::vector<int>& floodIndices, std::vector<bool>& isFloodIndex)
+void DataSubset::updateIsFloodIndex(const int numPoints, const std::vector<int>& floodIndices, PointSelection& isFloodIndex)
 {
     // must be put after orderSpatially() and before computeSubsetData()
-    isFloodIndex.clear();
-    isFloodIndex.resize(numPoints, false);
-    for (int idx : floodIndices) {
-        if (idx < isFloodIndex.size()) {
-            isFloodIndex[idx] = true;
-        }
-        else {
-            qDebug() << "DataSubset::updateIsFloodIndex(): idx out of range: " << idx;
-            qWarning() << "ERROR: allFloodNodesIndices might do not match active dataset."; // TODO: tie floodfill data to specific datasets
-            return;
-        }
+    if (!isFloodIndex.assign(numPoints, floodIndices)) {
+        qDebug() << "DataSubset::updateIsFloodIndex(): idx out of range";
+        qWarning() << "ERROR: allFloodNodesIndices might do not match active dataset."; // TODO: tie floodfill data to specific datasets
     }
 }
 
-void DataSubset::updateFloodFillOnSlice(const std::vector<bool>& isFloodIndex, const std::vector<int>& floodIndices, const std::vector<int>& onSliceIndices, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
+void DataSubset::updateFloodFillOnSlice(const PointSelection& isFloodIndex, const std::vector<int>& floodIndices, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
 {
-    
-    isFloodOnSlice.clear();
-    isFloodOnSlice.resize(onSliceIndices.size(), false);
-    for (int i = 0; i < onSliceIndices.size(); i++)
-    {
-        isFloodOnSlice[i] = isFloodIndex[onSliceIndices[i]];
-    }
+    isFloodOnSlice = isFloodIndex.gather(onSliceIndices);
 
     //qDebug() << "DataSubset::updateIsFloodOnSlice(): _isFloodOnSlice size" << isFloodOnSlice.size();
   
-    onSliceFloodIndices.clear();   
-    std::set<int> sliceIndicesSet(onSliceIndices.begin(), onSliceIndices.end());
-    for (int i = 0; i < floodIndices.size(); ++i) {
-        if (sliceIndicesSet.find(floodIndices[i]) != sliceIndicesSet.end()) {
-            onSliceFloodIndices.push_back(floodIndices[i]);
+    // one bit test per flood index keeps the flood order, no set of the slice is built
+    onSliceFloodIndices.clear();
+    for (int idx : floodIndices) {
+        if (idx >= 0 && idx < onSliceMask.size() && onSliceMask.test(idx)) {
+            onSliceFloodIndices.push_back(idx);
         }
     }
 
     //qDebug() << "DataSubset::updateIsFloodOnSlice(): _onSliceFloodIndices size" << onSliceFloodIndices.size();
 }
 
-void DataSubset::updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex)
+void DataSubset::updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex)
 {   // for 2D data
     std::vector<bool> selected;
     positionDataset->selectedLocalIndices(selection->indices, selected);
 
+    _waveAggregates = WaveAggregates();
     floodIndices.clear();
     waveNumbers.clear();
-    isFloodIndex.clear();
 
     // TODO: check if the values in indices are within range of int
     floodIndices.assign(selection->indices.begin(), selection->indices.end());
 
     waveNumbers.resize(floodIndices.size(), 1);// fake wave numbers to avoid crash
 
-    isFloodIndex.resize(positionDataset->getNumPoints(), 0);
-    for (std::size_t i = 0; i < selected.size(); i++)
-        isFloodIndex[i] = selected[i] ? 1 : 0;
+    isFloodIndex.resize(positionDataset->getNumPoints());
+    const int numSelectable = std::min(static_cast<int>(selected.size()), isFloodIndex.size());
+    for (int i = 0; i < numSelectable; i++)
+        if (selected[i])
+            isFloodIndex.set(i);
 }
 
-void DataSubset::updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, const std::vector<int>& onSliceIndices, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
+void DataSubset::updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices)
 {   // for 3D data
-    std::vector<bool> selected;
-    positionDataset->selectedLocalIndices(selection->indices, selected);
+    updateSelectedData(positionDataset, selection, floodIndices, waveNumbers, isFloodIndex);
 
-    floodIndices.clear();
-    waveNumbers.clear();
-    isFloodIndex.clear();
+    // additional part for 3D data
+    updateFloodFillOnSlice(isFloodIndex, floodIndices, onSliceIndices, onSliceMask, isFloodOnSlice, onSliceFloodIndices);
+}
 
-    // TODO: check if the values in indices are within range of int
-    floodIndices.assign(selection->indices.begin(), selection->indices.end());
+void DataSubset::computeSubsetData(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix)
+{
+    if (indices.empty()) {
+        qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
+        return;
+    }
 
-    waveNumbers.resize(floodIndices.size(), 1);// fake wave numbers to avoid crash
+    // copying whole rows would stride across all columns for every element, the kernel gathers column by column
+    gatherDenseRows(dataMatrix, indices, subsetDataMatrix);
+}
 
-    isFloodIndex.resize(positionDataset->getNumPoints(), 0);
-    for (std::size_t i = 0; i < selected.size(); i++)
-        isFloodIndex[i] = selected[i] ? 1 : 0;
+void DataSubset::computeSubsetData(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, DataMatrix& subsetDataMatrix)
+{
+    if (indices.empty()) {
+        qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
+        return;
+    }
 
-    // additional part for 3D data
-    isFloodOnSlice.clear();
-    onSliceFloodIndices.clear();
+    // walks the non-zeros of each column once instead of reading every row
+    gatherSparseRows(dataMatrix, offsets, indices, subsetDataMatrix);
+}
 
-    isFloodOnSlice.resize(onSliceIndices.size(), false);
-    for (int i = 0; i < onSliceIndices.size(); i++)
-    {
-        isFloodOnSlice[i] = isFloodIndex[onSliceIndices[i]];
+void DataSubset::computeSubsetData(const QuantizedMatrix& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix)
+{
+    if (indices.empty()) {
+        qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
+        return;
     }
 
-    std::set<int> sliceIndicesSet(onSliceIndices.begin(), onSliceIndices.end());
-    for (int i = 0; i < floodIndices.size(); ++i) {
-        if (sliceIndicesSet.find(floodIndices[i]) != sliceIndicesSet.end()) {
-            onSliceFloodIndices.push_back(floodIndices[i]);
-        }
-    }
+    dataMatrix.gatherRows(indices, subsetDataMatrix);
 }
 
-void DataSubset::computeSubsetData(const DataMatrix& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix)
+void DataSubset::computeSubsetData(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix)
 {
     if (indices.empty()) {
         qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
         return;
     }
 
-    int rows = indices.size();
-    int cols = dataMatrix.cols();
+    gatherDenseRows(dataMatrix, indices, dimIndices, subsetDataMatrix);
+}
 
-    subsetDataMatrix.resize(rows, cols);
+void DataSubset::computeSubsetData(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix)
+{
+    if (indices.empty()) {
+        qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
+        return;
+    }
 
-#pragma omp parallel for
-    for (int i = 0; i < rows; ++i)
-    {
-        int index = indices[i];
-        subsetDataMatrix.row(i) = dataMatrix.row(index);
+    gatherSparseRows(dataMatrix, offsets, indices, dimIndices, subsetDataMatrix);
+}
+
+void DataSubset::computeSubsetData(const QuantizedMatrix& dataMatrix, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix)
+{
+    if (indices.empty()) {
+        qDebug() << "WARNING: DataSubset::computeSubsetData(): empty indices";
+        return;
     }
+
+    dataMatrix.gatherRows(indices, dimIndices, subsetDataMatrix);
 }
 
 void DataSubset::computeSubsetDataAvgExpr(const DataMatrix& dataMatrix, const std::vector<QString>& clusterNames, const std::unordered_map<QString, int>& clusterToRowMap, DataMatrix& subsetDataMatrix)
 {
-    subsetDataMatrix.resize(clusterNames.size(), dataMatrix.cols());
+    std::vector<int> clusterIndices(clusterNames.size(), 0);
+    std::vector<int> missingClusters;
 
-#pragma omp parallel for
     for (int i = 0; i < clusterNames.size(); ++i) {
-        QString clusterName = clusterNames[i];
-
-        auto it = clusterToRowMap.find(clusterName);
+        auto it = clusterToRowMap.find(clusterNames[i]);
         if (it == clusterToRowMap.end()) {
-            #pragma omp critical
-            qDebug() << "Error: clusterName " << clusterName << " not found in _clusterAliasToRowMap";
+            qDebug() << "Error: clusterName " << clusterNames[i] << " not found in _clusterAliasToRowMap";
+            missingClusters.push_back(i);
             continue;
         }
-        int clusterIndex = it->second;
-
-        subsetDataMatrix.row(i) = dataMatrix.row(clusterIndex);
+        clusterIndices[i] = it->second;
     }
 
+    gatherDenseRows(dataMatrix, clusterIndices, subsetDataMatrix);
+
+    for (int i : missingClusters)
+        subsetDataMatrix.row(i).setZero();
+
     //qDebug() << "DataSubset::computeSubsetDataAvgExpr(): subset num rows (clusters): " << subsetDataMatrix.rows() << ", num columns (genes): " << subsetDataMatrix.cols();
 }
+
+int DataSubset::updateFloodMoments(const DataMatrixRef& dataMatrix, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey)
+{
+    const RowGather gatherRows = [this, &dataMatrix](const std::vector<int>& rows, DataMatrix& rowData) {
+        computeSubsetData(dataMatrix, rows, rowData);
+    };
+
+    return updateFloodMoments(dataMatrix.rows(), dataMatrix.cols(), floodIndices, positions, positionKey, [&](const std::vector<int>& added, const std::vector<int>& removed) {
+        accumulateGatheredRows(added, 1.0, positions, gatherRows);
+        accumulateGatheredRows(removed, -1.0, positions, gatherRows);
+    });
+}
+
+int DataSubset::updateFloodMoments(const QuantizedMatrix& dataMatrix, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey)
+{
+    const RowGather gatherRows = [&dataMatrix](const std::vector<int>& rows, DataMatrix& rowData) {
+        dataMatrix.gatherRows(rows, rowData);
+    };
+
+    return updateFloodMoments(dataMatrix.rows(), dataMatrix.cols(), floodIndices, positions, positionKey, [&](const std::vector<int>& added, const std::vector<int>& removed) {
+        accumulateGatheredRows(added, 1.0, positions, gatherRows);
+        accumulateGatheredRows(removed, -1.0, positions, gatherRows);
+    });
+}
+
+int DataSubset::updateFloodMoments(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey)
+{
+    const int numRows = dataMatrix.rows();
+    const int numCols = dataMatrix.cols();
+
+    return updateFloodMoments(numRows, numCols, floodIndices, positions, positionKey, [&](const std::vector<int>& added, const std::vector<int>& removed) {
+        const bool keepPositions = _floodMoments.positionKey != FloodMoments::noPositions;
+        const int numChanged = added.size() + removed.size();
+        if (numChanged == 0)
+            return;
+
+        const int numAxes = _floodMoments.getNumAxes();
+        double netCount = static_cast<double>(added.size()) - static_cast<double>(removed.size());
+        Eigen::RowVectorXd netPositionSum = Eigen::RowVectorXd::Zero(numAxes);
+        if (keepPositions) {
+            for (int row : added)
+                netPositionSum += positions.row(row).cast<double>();
+            for (int row : removed)
+                netPositionSum -= positions.row(row).cast<double>();
+        }
+
+        // a column cannot be read by row, so either look up each changed row (binary search) or walk all its non-zeros once
+        const double nonZerosPerColumn = static_cast<double>(dataMatrix.nonZeros()) / std::max(1, numCols);
+        const bool lookupRows = numChanged * std::log2(std::max(2.0, nonZerosPerColumn)) < nonZerosPerColumn;
+
+        // +1 for added, -1 for removed and 0 for unchanged rows
+        std::vector<signed char> rowSign;
+        if (!lookupRows) {
+            rowSign.assign(numRows, 0);
+            for (int row : added)
+                rowSign[row] = 1;
+            for (int row : removed)
+                rowSign[row] = -1;
+        }
+
+#pragma omp parallel
+        {
+            Eigen::RowVectorXd sumCross(numAxes);
+
+#pragma omp for
+            for (int c = 0; c < numCols; c++) {
+                // sums of the stored values, the standardized value is stored - offset
+                double sum = 0.0;
+                double sumSquares = 0.0;
+                sumCross.setZero();
+
+                auto addValue = [&](int row, double sign, double value) {
+                    sum += sign * value;
+                    sumSquares += sign * value * value;
+                    if (keepPositions)
+                        sumCross += (sign * value) * positions.row(row).cast<double>();
+                };
+
+                if (lookupRows) {
+                    for (int row : added)
+                        addValue(row, 1.0, dataMatrix.coeff(row, c));
+                    for (int row : removed)
+                        addValue(row, -1.0, dataMatrix.coeff(row, c));
+                }
+                else {
+                    for (SparseDataMatrix::InnerIterator it(dataMatrix, c); it; ++it)
+                        if (rowSign[it.index()] != 0)
+                            addValue(it.index(), rowSign[it.index()], it.value());
+                }
+
+                const double offset = offsets[c];
+                _floodMoments.sum[c] += sum - offset * netCount;
+                _floodMoments.sumSquares[c] += sumSquares - 2.0 * offset * sum + offset * offset * netCount;
+                if (keepPositions)
+                    _floodMoments.sumCross.row(c) += sumCross - offset * netPositionSum;
+            }
+        }
+    });
+}
+
+int DataSubset::updateFloodMoments(int numRows, int numCols, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey, const FloodAccumulator& accumulate)
+{
+    if (positionKey != FloodMoments::noPositions && positions.rows() < numRows) {
+        qDebug() << "ERROR: DataSubset::updateFloodMoments(): positions.rows() " << positions.rows() << " < numRows " << numRows;
+        return 0;
+    }
+
+    PointSelection floodMask;
+    if (!floodMask.assign(numRows, floodIndices))
+        qDebug() << "WARNING: DataSubset::updateFloodMoments(): flood indices out of range are ignored";
+
+    // a different data size or new positions need a full recompute
+    bool recompute = _floodMask.size() != numRows || _floodMoments.getNumGenes() != numCols ||
+        (positionKey != FloodMoments::noPositions && positionKey != _floodMoments.positionKey);
+
+    std::vector<int> added;
+    std::vector<int> removed;
+
+    if (!recompute) {
+        added = floodMask.difference(_floodMask);
+        removed = _floodMask.difference(floodMask);
+
+        // a recompute reads every flood point once, so the update only pays off if fewer points changed
+        recompute = added.size() + removed.size() >= static_cast<size_t>(floodMask.count());
+    }
+
+    if (recompute) {
+        _floodMoments.numPoints = 0;
+        _floodMoments.sum.setZero(numCols);
+        _floodMoments.sumSquares.setZero(numCols);
+        _floodMoments.sumCross.setZero(numCols, positions.cols());
+        _floodMoments.positionSum.setZero(positions.cols());
+        _floodMoments.positionSumSquares.setZero(positions.cols());
+
+        added = floodMask.toIndices();
+        removed.clear();
+    }
+
+    // the cross moments are dropped as soon as an update does not keep them up to date
+    _floodMoments.positionKey = positionKey;
+
+    accumulate(added, removed);
+
+    if (positionKey != FloodMoments::noPositions) {
+        for (int row : added) {
+            const Eigen::VectorXd position = positions.row(row).transpose().cast<double>();
+            _floodMoments.positionSum += position;
+            _floodMoments.positionSumSquares += position.cwiseAbs2();
+        }
+        for (int row : removed) {
+            const Eigen::VectorXd position = positions.row(row).transpose().cast<double>();
+            _floodMoments.positionSum -= position;
+            _floodMoments.positionSumSquares -= position.cwiseAbs2();
+        }
+    }
+
+    _floodMoments.numPoints += static_cast<int>(added.size()) - static_cast<int>(removed.size());
+    _floodMask = std::move(floodMask);
+
+    return added.size() + removed.size();
+}
+
+void DataSubset::accumulateGatheredRows(const std::vector<int>& rows, double sign, const DataMatrix& positions, const RowGather& gatherRows)
+{
+    if (rows.empty())
+        return;
+
+    const bool keepPositions = _floodMoments.positionKey != FloodMoments::noPositions;
+    const int numCols = _floodMoments.getNumGenes();
+
+    // at most about 1M gathered values at a time, so a full recompute does not materialize the whole flood
+    const int chunkSize = std::max(64, (1 << 20) / std::max(1, numCols));
+
+    std::vector<int> chunkRows;
+    DataMatrix rowData;
+    DataMatrix chunkPositions;
+
+    for (size_t start = 0; start < rows.size(); start += chunkSize) {
+        chunkRows.assign(rows.begin() + start, rows.begin() + std::min(rows.size(), start + chunkSize));
+        gatherRows(chunkRows, rowData);
+
+        const int numChunkRows = chunkRows.size();
+
+#pragma omp parallel for
+        for (int c = 0; c < numCols; c++) {
+            const float* values = rowData.col(c).data();
+            double sum = 0.0;
+            double sumSquares = 0.0;
+
+            for (int i = 0; i < numChunkRows; i++) {
+                const double value = values[i];
+                sum += value;
+                sumSquares += value * value;
+            }
+
+            _floodMoments.sum[c] += sign * sum;
+            _floodMoments.sumSquares[c] += sign * sumSquares;
+        }
+
+        // the cross moments with all axes at once, as one product of the chunk with its positions
+        if (keepPositions) {
+            gatherDenseRows(positions, chunkRows, chunkPositions);
+            _floodMoments.sumCross += sign * (rowData.transpose() * chunkPositions).cast<double>();
+        }
+    }
+}
+
+bool DataSubset::updateWaveLabelCounts(const std::vector<int>& floodIndices, const std::vector<int>& waveNumbers, const std::vector<int>& pointLabels, int numLabels)
+{
+    if (_waveAggregates.labelCounts.size() > 0)
+        return false;
+
+    std::vector<int> rows;
+    std::vector<int> waveRows;
+    if (!collectWaveRows(pointLabels.size(), floodIndices, waveNumbers, rows, waveRows))
+        return false;
+
+    _waveAggregates.labelCounts.setZero(_waveAggregates.getNumWaves(), numLabels);
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        const int label = pointLabels[rows[i]];
+        if (label >= 0 && label < numLabels)
+            _waveAggregates.labelCounts(waveRows[i], label)++;
+    }
+
+    return true;
+}
+
+bool DataSubset::collectWaveRows(int numRows, const std::vector<int>& floodIndices, const std::vector<int>& waveNumbers, std::vector<int>& rows, std::vector<int>& waveRows)
+{
+    if (floodIndices.size() != waveNumbers.size()) {
+        qDebug() << "ERROR: DataSubset::collectWaveRows(): " << floodIndices.size() << " flood indices but " << waveNumbers.size() << " wave numbers";
+        return false;
+    }
+
+    const int numWaves = waveNumbers.empty() ? 0 : *std::max_element(waveNumbers.begin(), waveNumbers.end());
+
+    rows.clear();
+    waveRows.clear();
+    rows.reserve(floodIndices.size());
+    waveRows.reserve(floodIndices.size());
+
+    _waveAggregates.waveCounts.setZero(numWaves);
+
+    for (size_t i = 0; i < floodIndices.size(); i++) {
+        if (floodIndices[i] < 0 || floodIndices[i] >= numRows || waveNumbers[i] < 1)
+            continue;
+
+        rows.push_back(floodIndices[i]);
+        waveRows.push_back(waveNumbers[i] - 1);
+        _waveAggregates.waveCounts[waveNumbers[i] - 1]++;
+    }
+
+    if (rows.size() != floodIndices.size())
+        qDebug() << "WARNING: DataSubset::collectWaveRows(): " << floodIndices.size() - rows.size() << " flood points out of range or without a wave are ignored";
+
+    return true;
+}
@@ -2,6 +2,9 @@
 
 #include "PointData/PointData.h"
 #include "DataMatrix.h"
+#include "GeneStats.h"
+#include "PointSelection.h"
+#include "QuantizedMatrix.h"
 
 #include <vector>
 #include <QDebug>
@@ -10,23 +13,81 @@ class DataSubset
 {
 public:
     // for 2D data
-    void updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex);
+    void updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex);
     // overloaded for 3D data
-    void updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, const std::vector<int>& onSliceIndices, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
+    void updateFloodFill(mv::Dataset<Points> floodFillDataset, const int numPoints, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
     // for 2D data
-    void updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex);
+    void updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex);
     // overloaded for 3D data
-    void updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, const std::vector<int>& onSliceIndices, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, std::vector<bool>& isFloodIndex, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
+    void updateSelectedData(mv::Dataset<Points> positionDataset, mv::Dataset<Points> selection, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, std::vector<int>& floodIndices, std::vector<int>& waveNumbers, PointSelection& isFloodIndex, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
 
-    void computeSubsetData(const DataMatrix& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix);
+    void computeSubsetData(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix);
+    // overloaded for sparse data, see DataStorage::getBaseSparseOffsets()
+    void computeSubsetData(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, DataMatrix& subsetDataMatrix);
+    // overloaded for quantized data, dequantized while gathering
+    void computeSubsetData(const QuantizedMatrix& dataMatrix, const std::vector<int>& indices, DataMatrix& subsetDataMatrix);
+
+    // only the columns \p dimIndices are gathered, column d of the subset is column dimIndices[d] of the data
+    void computeSubsetData(const DataMatrixRef& dataMatrix, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix);
+    void computeSubsetData(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix);
+    void computeSubsetData(const QuantizedMatrix& dataMatrix, const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetDataMatrix);
+
+    /**
+     * Update the running moments of the flood \p floodIndices over the rows of \p dataMatrix, see getFloodMoments()
+     * Only the points that entered or left the flood since the last update are read, unless that is more than a full recompute
+     * If \p positionKey is not FloodMoments::noPositions, the cross moments with \p positions are kept as well,
+     * one row per point and one column per axis. Positions centered on the mean of all points keep the cross moments accurate
+     * @return the number of points that were read
+     */
+    int updateFloodMoments(const DataMatrixRef& dataMatrix, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey);
+    // overloaded for sparse data, see DataStorage::getBaseSparseOffsets()
+    int updateFloodMoments(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey);
+    // overloaded for quantized data
+    int updateFloodMoments(const QuantizedMatrix& dataMatrix, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey);
+
+    const FloodMoments& getFloodMoments() const { return _floodMoments; }
+
+    /** Recompute the moments from scratch on the next update, e.g. after the base data changed */
+    void invalidateFloodMoments() { _floodMask.clear(); }
+
+    /**
+     * Count the points of every label per wave, \p pointLabels holds a label in [0, numLabels) or -1 for every point
+     * The counts are computed once per flood-fill, later calls return right away until the flood-fill or the labels change
+     * @return true if the counts were computed
+     */
+    bool updateWaveLabelCounts(const std::vector<int>& floodIndices, const std::vector<int>& waveNumbers, const std::vector<int>& pointLabels, int numLabels);
+
+    /** Recount the labels on the next updateWaveLabelCounts(), e.g. after the point labels changed */
+    void invalidateWaveLabelCounts() { _waveAggregates.labelCounts.resize(0, 0); }
+
+    const WaveAggregates& getWaveAggregates() const { return _waveAggregates; }
 
     void computeSubsetDataAvgExpr(const DataMatrix& dataMatrix, const std::vector<QString>& clusterNames, const std::unordered_map<QString, int>& clusterToRowMap, DataMatrix& subsetDataMatrix);
 
 private:
 
+    // adds the points that entered and subtracts the points that left the flood
+    using FloodAccumulator = std::function<void(const std::vector<int>& added, const std::vector<int>& removed)>;
+    // gathers rows of the base data as standardized values
+    using RowGather = std::function<void(const std::vector<int>& rows, DataMatrix& rowData)>;
+
+    int updateFloodMoments(int numRows, int numCols, const std::vector<int>& floodIndices, const DataMatrix& positions, int positionKey, const FloodAccumulator& accumulate);
+
+    // accumulates \p rows in chunks of gathered rows, for storage that can be read by row
+    void accumulateGatheredRows(const std::vector<int>& rows, double sign, const DataMatrix& positions, const RowGather& gatherRows);
+
+    // flood points within \p numRows and their wave row (wave number - 1), sets the wave counts, false if the waves do not match the flood
+    bool collectWaveRows(int numRows, const std::vector<int>& floodIndices, const std::vector<int>& waveNumbers, std::vector<int>& rows, std::vector<int>& waveRows);
+
     void processFloodFillDataset(mv::Dataset<Points> floodFillDataset, std::vector<int>& floodIndices, std::vector<int>& waveNumbers);
 
-    void updateIsFloodIndex(const int numPoints, const std::vector<int>& floodIndices, std::vector<bool>& isFloodIndex);
+    void updateIsFloodIndex(const int numPoints, const std::vector<int>& floodIndices, PointSelection& isFloodIndex);
+
+    // onSliceMask holds the on-slice points as global indices, onSliceIndices the same points in slice order
+    void updateFloodFillOnSlice(const PointSelection& isFloodIndex, const std::vector<int>& floodIndices, const std::vector<int>& onSliceIndices, const PointSelection& onSliceMask, PointSelection& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
 
-    void updateFloodFillOnSlice(const std::vector<bool>& isFloodIndex, const std::vector<int>& floodIndices, const std::vector<int>& onSliceIndices, std::vector<bool>& isFloodOnSlice, std::vector<int>& onSliceFloodIndices);
+private:
+    FloodMoments        _floodMoments;
+    PointSelection      _floodMask;        // flood of _floodMoments, empty if they need a full recompute
+    WaveAggregates      _waveAggregates;   // of the current flood-fill, reset whenever it changes
 };
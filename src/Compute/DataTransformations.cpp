@@ -1,43 +1,92 @@
 #include "DataTransformations.h"
 
-void standardizeData(DataMatrix& dataMatrix, std::vector<float>& variances)
+#include <algorithm>
+#include <cmath>
+
+namespace
 {
-    int numPoints = dataMatrix.rows();
-    int numDimensions = dataMatrix.cols();
+    // 1024 floats are 4 KB, so the second read of a block for its squared deviations hits L1
+    constexpr int momentsBlockSize = 1024;
 
-    std::vector<float> means(numDimensions);
-    variances.resize(numDimensions);
+    // min-max normalization as in normalizeDataEigen()
+    inline float normalizationRange(const ColumnMoments& moments)
+    {
+        float range = moments.max - moments.min;
+        return range == 0 ? 1.0f : range;
+    }
+}
 
-#pragma omp parallel for
-    for (int d = 0; d < numDimensions; d++)
+ColumnMoments computeColumnMoments(const float* column, int numPoints)
+{
+    ColumnMoments moments;
+    if (numPoints <= 0)
+        return moments;
+
+    // running count, mean and sum of squared deviations, accumulated in double so long columns keep their precision
+    double count = 0;
+    double mean = 0;
+    double m2 = 0;
+    float minVal = column[0];
+    float maxVal = column[0];
+
+    for (int start = 0; start < numPoints; start += momentsBlockSize)
     {
-        // Compute mean
-        float mean = dataMatrix.col(d).mean();
+        const int blockSize = std::min(momentsBlockSize, numPoints - start);
+        Eigen::Map<const Eigen::ArrayXf> block(column + start, blockSize);
+
+        const double blockMean = static_cast<double>(block.sum()) / blockSize;
+        const double blockM2 = (block - static_cast<float>(blockMean)).square().sum();
+        minVal = std::min(minVal, block.minCoeff());
+        maxVal = std::max(maxVal, block.maxCoeff());
+
+        // Chan et al. merge of the running and the block statistics
+        const double delta = blockMean - mean;
+        const double mergedCount = count + blockSize;
+        mean += delta * blockSize / mergedCount;
+        m2 += blockM2 + delta * delta * count * blockSize / mergedCount;
+        count = mergedCount;
+    }
 
-        //mean /= numPoints;
-        means[d] = mean;
+    moments.mean = static_cast<float>(mean);
+    moments.variance = static_cast<float>(m2 / count);
+    moments.min = minVal;
+    moments.max = maxVal;
 
-        // Compute variance
-        variances[d] = (dataMatrix.col(d).array() - mean).square().sum() / numPoints;
+    return moments;
+}
+
+float standardizeColumn(const float* column, float* standardizedColumn, int numPoints, float* zeroLevel, float* normalizedColumn)
+{
+    const ColumnMoments moments = computeColumnMoments(column, numPoints);
 
-        // If variance is 0, then don't try to divide the data by it
-        if (variances[d] <= 0) continue;
+    // If variance is 0, then don't try to divide the data by it, the column keeps its raw values
+    const bool hasVariance = moments.variance > 0;
+    const float shift = hasVariance ? moments.mean : 0.0f;
+    const float invStddev = hasVariance ? 1.0f / std::sqrt(moments.variance) : 1.0f;
 
-        // Standardize data
-        float invStddev = 1.0f / sqrt(variances[d]);
+    if (zeroLevel != nullptr)
+        *zeroLevel = (0.0f - shift) * invStddev;
 
-        for (int i = 0; i < numPoints; i++)
-        {
-            dataMatrix(i, d) -= mean;
-            dataMatrix(i, d) *= invStddev;
-        }
+    if (normalizedColumn == nullptr)
+    {
+        Eigen::Map<Eigen::ArrayXf>(standardizedColumn, numPoints) = (Eigen::Map<const Eigen::ArrayXf>(column, numPoints) - shift) * invStddev;
+        return moments.variance;
     }
 
-    //// Print means and variances
-    //for (int d = 0; d < numDimensions; d++)
-    //    std::cout << "Mean " << d << " " << means[d] << std::endl;
-    //for (int d = 0; d < numDimensions; d++)
-    //    std::cout << "Variance " << d << " " << variances[d] << std::endl;
+    // Min-max normalization is invariant to standardizing, so both outputs are written per block while the raw block is still in L1,
+    // before it may be overwritten by the standardized values
+    const float range = normalizationRange(moments);
+
+    for (int start = 0; start < numPoints; start += momentsBlockSize)
+    {
+        const int blockSize = std::min(momentsBlockSize, numPoints - start);
+        Eigen::Map<const Eigen::ArrayXf> block(column + start, blockSize);
+
+        Eigen::Map<Eigen::ArrayXf>(normalizedColumn + start, blockSize) = ((block - moments.min) / range).min(0.99999f);
+        Eigen::Map<Eigen::ArrayXf>(standardizedColumn + start, blockSize) = (block - shift) * invStddev;
+    }
+
+    return moments.variance;
 }
 
 void normalizeData(const DataMatrix& dataMatrix, std::vector<std::vector<float>>& normalizedData)
@@ -59,7 +108,7 @@ void normalizeData(const DataMatrix& dataMatrix, std::vector<std::vector<float>>
 }
 
 
-void normalizeDataEigen(const DataMatrix& dataMatrix, DataMatrix& normalizedDataMatrix)
+void normalizeDataEigen(const DataMatrixRef& dataMatrix, DataMatrix& normalizedDataMatrix)
 {
     normalizedDataMatrix.resize(dataMatrix.rows(), dataMatrix.cols());
     
@@ -68,14 +117,11 @@ void normalizeDataEigen(const DataMatrix& dataMatrix, DataMatrix& normalizedData
     {
         auto col = dataMatrix.col(d);
 
-        float minVal = col.minCoeff();
-        float maxVal = col.maxCoeff();
-        float range = maxVal - minVal;
-
-        // Avoid division by zero
-        if (range == 0) range = 1;
+        // min and max from the one pass kernel, avoids division by zero
+        ColumnMoments moments = computeColumnMoments(col.data(), col.size());
+        float range = normalizationRange(moments);
 
         // Normalize the column
-        normalizedDataMatrix.col(d) = ((col.array() - minVal) / range).min(0.99999f);
+        normalizedDataMatrix.col(d) = ((col.array() - moments.min) / range).min(0.99999f);
     }
 }
@@ -4,6 +4,27 @@
 
 #include <iostream>
 
-void standardizeData(DataMatrix& dataMatrix, std::vector<float>& variances);
+/** Mean, (population) variance, min and max of a column */
+struct ColumnMoments
+{
+    float mean = 0;
+    float variance = 0;
+    float min = 0;
+    float max = 0;
+};
+
+/**
+ * Compute the moments of \p numPoints values in a single pass over memory
+ * Blocks that fit in L1 are reduced with vectorized sums, the block results are merged with Chan's parallel variance update
+ */
+ColumnMoments computeColumnMoments(const float* column, int numPoints);
+
+/**
+ * Standardize one column of \p numPoints values into \p standardizedColumn (may alias \p column), returns the variance
+ * If given, \p zeroLevel receives the standardized value of a raw zero
+ * If given, \p normalizedColumn receives the min-max normalized values in the same pass, as normalizeDataEigen()
+ */
+float standardizeColumn(const float* column, float* standardizedColumn, int numPoints, float* zeroLevel = nullptr, float* normalizedColumn = nullptr);
+
 void normalizeData(const DataMatrix& dataMatrix, std::vector<std::vector<float>>& normalizedData);
-void normalizeDataEigen(const DataMatrix& dataMatrix, DataMatrix& normalizedDataMatrix);
+void normalizeDataEigen(const DataMatrixRef& dataMatrix, DataMatrix& normalizedDataMatrix);
@@ -0,0 +1,195 @@
+#include "GeneRanks.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+bool GeneRanks::compute(const DataMatrixRef& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::function<bool()>& nextColumn)
+{
+    return compute(dataMatrix.rows(), dataMatrix.cols(), [&](int col, std::vector<std::pair<float, int>>& entries) {
+        const float* column = dataMatrix.col(col).data();
+        for (int i = 0; i < dataMatrix.rows(); i++)
+            if (column[i] != zeroLevels[col])
+                entries.emplace_back(column[i], i);
+        return zeroLevels[col];
+    }, nextColumn);
+}
+
+bool GeneRanks::compute(const SparseDataMatrix& dataMatrix, const std::function<bool()>& nextColumn)
+{
+    // the stored values are the standardized values plus a constant per column, so they rank the same
+    return compute(dataMatrix.rows(), dataMatrix.cols(), [&](int col, std::vector<std::pair<float, int>>& entries) {
+        for (SparseDataMatrix::InnerIterator it(dataMatrix, col); it; ++it)
+            entries.emplace_back(it.value(), it.index());
+        return 0.0f;
+    }, nextColumn);
+}
+
+bool GeneRanks::compute(const QuantizedMatrix& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::function<bool()>& nextColumn)
+{
+    return compute(dataMatrix.rows(), dataMatrix.cols(), [&](int col, std::vector<std::pair<float, int>>& entries) {
+        thread_local std::vector<float> decodedColumn;
+        decodedColumn.resize(dataMatrix.rows());
+        dataMatrix.decodeColumn(col, decodedColumn.data());
+
+        // a raw zero is stored with the same code as the zero level, so compare in the quantized domain
+        const float zeroLevel = dataMatrix.roundTrip(col, zeroLevels[col]);
+        for (int i = 0; i < dataMatrix.rows(); i++)
+            if (decodedColumn[i] != zeroLevel)
+                entries.emplace_back(decodedColumn[i], i);
+        return zeroLevel;
+    }, nextColumn);
+}
+
+bool GeneRanks::compute(int numRows, int numCols, const ColumnEntries& columnEntries, const std::function<bool()>& nextColumn)
+{
+    clear();
+
+    _zeroRanks.resize(numCols);
+    _tieTerms.resize(numCols);
+
+    // the rank differences are collected per column first, the number of points off the zero level is only known after ranking
+    std::vector<std::vector<int>> columnRows(numCols);
+    std::vector<std::vector<float>> columnRanks(numCols);
+    std::atomic<bool> cancelled = false;
+
+#pragma omp parallel
+    {
+        std::vector<std::pair<float, int>> entries;
+
+#pragma omp for schedule(dynamic)
+        for (int c = 0; c < numCols; c++)
+        {
+            // the remaining columns are skipped once cancelled
+            if (cancelled || (nextColumn && !nextColumn()))
+            {
+                cancelled = true;
+                continue;
+            }
+
+            entries.clear();
+            const float zeroLevel = columnEntries(c, entries);
+            std::sort(entries.begin(), entries.end());
+
+            // the zero-level points sit between the values below and above the zero level
+            const int numEntries = static_cast<int>(entries.size());
+            const int numZeros = numRows - numEntries;
+            const int numBelow = static_cast<int>(std::lower_bound(entries.begin(), entries.end(), std::make_pair(zeroLevel, -1)) - entries.begin());
+            const double zeroRank = numBelow + (numZeros + 1) / 2.0;
+            double tieTerm = static_cast<double>(numZeros) * numZeros * numZeros - numZeros;
+
+            columnRows[c].resize(numEntries);
+            columnRanks[c].resize(numEntries);
+
+            for (int first = 0; first < numEntries;)
+            {
+                int last = first + 1;
+                while (last < numEntries && entries[last].first == entries[first].first)
+                    last++;
+
+                const double numTied = last - first;
+                const double firstRank = first + 1 + (first >= numBelow ? numZeros : 0);
+                const float rankOffset = static_cast<float>(firstRank + (numTied - 1) / 2.0 - zeroRank);
+                tieTerm += numTied * numTied * numTied - numTied;
+
+                for (int k = first; k < last; k++)
+                {
+                    columnRows[c][k] = entries[k].second;
+                    columnRanks[c][k] = rankOffset;
+                }
+
+                first = last;
+            }
+
+            _zeroRanks[c] = static_cast<float>(zeroRank);
+            _tieTerms[c] = tieTerm;
+        }
+    }
+
+    if (cancelled)
+    {
+        clear();
+        return false;
+    }
+
+    // compressed columns first, the assignment to row-major storage transposes them
+    SparseDataMatrix rankColumns(numRows, numCols);
+    int* outerIndex = rankColumns.outerIndexPtr();
+    outerIndex[0] = 0;
+    for (int c = 0; c < numCols; c++)
+        outerIndex[c + 1] = outerIndex[c] + static_cast<int>(columnRows[c].size());
+    rankColumns.resizeNonZeros(outerIndex[numCols]);
+
+#pragma omp parallel for
+    for (int c = 0; c < numCols; c++)
+    {
+        // the rows of a column have to be ascending in compressed storage
+        std::vector<int> order(columnRows[c].size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return columnRows[c][a] < columnRows[c][b]; });
+
+        int* rows = rankColumns.innerIndexPtr() + outerIndex[c];
+        float* ranks = rankColumns.valuePtr() + outerIndex[c];
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            rows[k] = columnRows[c][order[k]];
+            ranks[k] = columnRanks[c][order[k]];
+        }
+
+        std::vector<int>().swap(columnRows[c]);
+        std::vector<float>().swap(columnRanks[c]);
+    }
+
+    _rankOffsets = rankColumns;
+    _numPoints = numRows;
+
+    qDebug() << "GeneRanks::compute(): ranked " << numCols << " genes of " << numRows << " points, " << _rankOffsets.nonZeros() << " points off the zero level";
+    return true;
+}
+
+void GeneRanks::clear()
+{
+    _numPoints = 0;
+    _rankOffsets.resize(0, 0);
+    _rankOffsets.data().squeeze();
+    _zeroRanks.resize(0);
+    _tieTerms.resize(0);
+}
+
+Eigen::VectorXd GeneRanks::rankSums(const std::vector<int>& indices, int& numInRange) const
+{
+    const int numGenes = getNumGenes();
+    const int numIndices = static_cast<int>(indices.size());
+    Eigen::VectorXd sums = Eigen::VectorXd::Zero(numGenes);
+    int numSummed = 0;
+
+#pragma omp parallel reduction(+:numSummed)
+    {
+        Eigen::VectorXd threadSums = Eigen::VectorXd::Zero(numGenes);
+
+#pragma omp for nowait
+        for (int i = 0; i < numIndices; i++)
+        {
+            if (indices[i] < 0 || indices[i] >= _numPoints)
+                continue;
+
+            numSummed++;
+            for (RankMatrix::InnerIterator it(_rankOffsets, indices[i]); it; ++it)
+                threadSums[it.index()] += it.value();
+        }
+
+#pragma omp critical
+        sums += threadSums;
+    }
+
+    if (numSummed != numIndices)
+        qDebug() << "WARNING: GeneRanks::rankSums(): " << numIndices - numSummed << " indices out of range are ignored";
+
+    // every selected point has at least the zero-level rank
+    sums += numSummed * _zeroRanks.cast<double>();
+    numInRange = numSummed;
+
+    return sums;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "DataMatrix.h"
+#include "QuantizedMatrix.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * Mid-ranks of every gene over all points of the base data, see DataStorage::getBaseRanks()
+ *
+ * The ranks are computed once, so the rank sum of a selection is a sum over the selected points and a Mann-Whitney test
+ * of a selection against the rest costs O(selection x genes) without sorting. Every gene keeps the rank shared by its
+ * zero-level points, only the points of other values are stored, as rows of rank differences to the zero-level rank.
+ * A stored rank costs a float and a row index, so for dense data without zeros the ranks take about twice the memory of the base data
+ */
+class GeneRanks
+{
+public:
+    using RankMatrix = Eigen::SparseMatrix<float, Eigen::RowMajor, int>;  // one row per point, so a selection reads only its rows
+
+    /**
+     * Rank the columns of dense data, \p zeroLevels is the stored value of a raw zero per gene
+     * If given, \p nextColumn is called before each column, returning false cancels the ranking and leaves the ranks cleared
+     * @return false if the ranking was cancelled
+     */
+    bool compute(const DataMatrixRef& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::function<bool()>& nextColumn = {});
+    // overloaded for sparse data, the implicit zeros are the zero level
+    bool compute(const SparseDataMatrix& dataMatrix, const std::function<bool()>& nextColumn = {});
+    // overloaded for quantized data
+    bool compute(const QuantizedMatrix& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::function<bool()>& nextColumn = {});
+
+    void clear();
+
+    bool isValid() const { return _numPoints > 0; }
+
+    int getNumPoints() const { return _numPoints; }
+    int getNumGenes() const { return _zeroRanks.size(); }
+
+    /** Sum of the ranks of the points \p indices per gene, the indices have to be unique; \p numInRange is set to the number of indices that were summed */
+    Eigen::VectorXd rankSums(const std::vector<int>& indices, int& numInRange) const;
+
+    /** Sum of t^3 - t over the groups of t tied points per gene, for the tie correction of the rank-sum variance */
+    const Eigen::VectorXd& getTieTerms() const { return _tieTerms; }
+
+private:
+    // collects the (value, row) pairs of the points of column col that are not at the zero level, and returns the zero level
+    using ColumnEntries = std::function<float(int col, std::vector<std::pair<float, int>>& entries)>;
+
+    bool compute(int numRows, int numCols, const ColumnEntries& columnEntries, const std::function<bool()>& nextColumn);
+
+private:
+    int                 _numPoints = 0;
+    RankMatrix          _rankOffsets;           // rank - zero-level rank of the points that are not at the zero level
+    Eigen::VectorXf     _zeroRanks;             // mid-rank of the zero-level points per gene
+    Eigen::VectorXd     _tieTerms;
+};
@@ -0,0 +1,53 @@
+#include "GeneSelection.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    float rankKey(float score)
+    {
+        return std::isnan(score) ? -std::numeric_limits<float>::infinity() : score;
+    }
+}
+
+std::vector<int> selectTopAbsoluteGenes(const std::vector<float>& scores, int k)
+{
+    const int numGenes = static_cast<int>(scores.size());
+    if (k < 0 || k > numGenes)
+    {
+        qDebug() << "WARNING: selectTopAbsoluteGenes(): " << k << " genes requested out of " << numGenes;
+        k = std::clamp(k, 0, numGenes);
+    }
+
+    // the keys are copied once, so the comparisons of the partial sort read one contiguous array
+    std::vector<float> keys(numGenes);
+    std::transform(scores.begin(), scores.end(), keys.begin(), [](float score) { return rankKey(std::abs(score)); });
+
+    auto larger = [&keys](int a, int b) { return keys[a] > keys[b] || (keys[a] == keys[b] && a < b); };
+
+    std::vector<int> indices(numGenes);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    if (k < numGenes)
+        std::nth_element(indices.begin(), indices.begin() + k, indices.end(), larger);
+
+    indices.resize(k);
+    std::sort(indices.begin(), indices.end(), larger);
+
+    return indices;
+}
+
+void sortGenesByScore(const std::vector<float>& scores, std::vector<int>& indices)
+{
+    // NaN scores go to the front, below every other score
+    std::sort(indices.begin(), indices.end(), [&scores](int a, int b) {
+        const float scoreA = rankKey(scores[a]);
+        const float scoreB = rankKey(scores[b]);
+        return scoreA < scoreB || (scoreA == scoreB && a < b);
+        });
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Index-only selection and ordering of genes by score, used by the gene filtering and the chart
+ *
+ * Only int permutations of the gene indices are built, the gene names are looked up by the callers afterwards.
+ * Ties are broken by the lower gene index and NaN scores rank last, so the order does not depend on the sort
+ */
+
+/** Indices of the \p k genes with the largest absolute \p scores, ordered from largest to smallest, O(G + k log k) */
+std::vector<int> selectTopAbsoluteGenes(const std::vector<float>& scores, int k);
+
+/** Order \p indices by ascending \p scores of the genes they point to */
+void sortGenesByScore(const std::vector<float>& scores, std::vector<int>& indices);
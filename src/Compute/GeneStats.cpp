@@ -0,0 +1,221 @@
+#include "GeneStats.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // gathers the rows of one column per call, reusing the scratch buffer of the calling thread
+    template<typename ValueAt>
+    void setColumnFromRows(GeneStats& stats, int col, const std::vector<int>& indices, int numRows, float zeroLevel, std::vector<float>& scratch, ValueAt valueAt)
+    {
+        const int numPoints = indices.empty() ? numRows : static_cast<int>(indices.size());
+        scratch.resize(numPoints);
+
+        if (indices.empty())
+            for (int i = 0; i < numPoints; i++)
+                scratch[i] = valueAt(i);
+        else
+            for (int i = 0; i < numPoints; i++)
+                scratch[i] = valueAt(indices[i]);
+
+        stats.setColumn(col, scratch.data(), zeroLevel);
+    }
+}
+
+Eigen::MatrixXf FloodMoments::positionCorrelation() const
+{
+    const int numGenes = getNumGenes();
+    const int numAxes = getNumAxes();
+    Eigen::MatrixXf correlation = Eigen::MatrixXf::Zero(numGenes, numAxes);
+
+    if (numPoints == 0 || numAxes == 0)
+        return correlation;
+
+    const Eigen::VectorXd positionMean = positionSum / numPoints;
+    const Eigen::VectorXd positionNorm = positionSumSquares - positionSum.cwiseProduct(positionMean);
+
+    for (int c = 0; c < numGenes; c++)
+    {
+        const double norm = sumSquares[c] - sum[c] * sum[c] / numPoints;
+        for (int a = 0; a < numAxes; a++)
+        {
+            const double covariance = sumCross(c, a) - sum[c] * positionMean[a];
+            const double value = covariance / std::sqrt(norm * positionNorm[a]);
+            correlation(c, a) = std::isfinite(value) ? static_cast<float>(value) : 0.0f;
+        }
+    }
+
+    return correlation;
+}
+
+Eigen::VectorXf WaveAggregates::meanWaveNumberPerLabel() const
+{
+    const int numLabels = labelCounts.cols();
+    Eigen::VectorXf meanWaveNumber = Eigen::VectorXf::Zero(numLabels);
+
+    const Eigen::VectorXd waveNumbers = Eigen::VectorXd::LinSpaced(getNumWaves(), 1, getNumWaves());
+
+    for (int label = 0; label < numLabels; label++)
+    {
+        const Eigen::VectorXd counts = labelCounts.col(label).cast<double>();
+        const double numPoints = counts.sum();
+        if (numPoints > 0)
+            meanWaveNumber[label] = static_cast<float>(counts.dot(waveNumbers) / numPoints);
+    }
+
+    return meanWaveNumber;
+}
+
+void GeneStats::resize(int numGenes, int numPoints)
+{
+    this->numPoints = numPoints;
+    sum.setZero(numGenes);
+    sumSquares.setZero(numGenes);
+    min.setZero(numGenes);
+    max.setZero(numGenes);
+    numNonZeros.setZero(numGenes);
+}
+
+void GeneStats::setColumn(int col, const float* values, float zeroLevel)
+{
+    double columnSum = 0.0;
+    double columnSumSquares = 0.0;
+    float columnMin = std::numeric_limits<float>::max();
+    float columnMax = std::numeric_limits<float>::lowest();
+    int columnNonZeros = 0;
+
+    for (int i = 0; i < numPoints; i++)
+    {
+        float value = values[i];
+        columnSum += value;
+        columnSumSquares += value * value;
+        columnMin = std::min(columnMin, value);
+        columnMax = std::max(columnMax, value);
+        columnNonZeros += value != zeroLevel;
+    }
+
+    sum[col] = columnSum;
+    sumSquares[col] = columnSumSquares;
+    min[col] = numPoints > 0 ? columnMin : 0.0f;
+    max[col] = numPoints > 0 ? columnMax : 0.0f;
+    numNonZeros[col] = columnNonZeros;
+}
+
+GeneStats computeGeneStats(const DataMatrixRef& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::vector<int>& indices)
+{
+    GeneStats stats;
+    const int numCols = static_cast<int>(dataMatrix.cols());
+    stats.resize(numCols, indices.empty() ? static_cast<int>(dataMatrix.rows()) : static_cast<int>(indices.size()));
+
+    if (indices.empty())
+    {
+#pragma omp parallel for
+        for (int c = 0; c < numCols; c++)
+            stats.setColumn(c, dataMatrix.col(c).data(), zeroLevels[c]);
+
+        return stats;
+    }
+
+#pragma omp parallel
+    {
+        std::vector<float> scratch;
+
+#pragma omp for
+        for (int c = 0; c < numCols; c++)
+        {
+            const float* column = dataMatrix.col(c).data();
+            setColumnFromRows(stats, c, indices, static_cast<int>(dataMatrix.rows()), zeroLevels[c], scratch, [column](int row) { return column[row]; });
+        }
+    }
+
+    return stats;
+}
+
+GeneStats computeGeneStats(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices)
+{
+    GeneStats stats;
+    const int numCols = static_cast<int>(dataMatrix.cols());
+    const int numPoints = indices.empty() ? static_cast<int>(dataMatrix.rows()) : static_cast<int>(indices.size());
+    stats.resize(numCols, numPoints);
+
+    std::vector<char> isSelected;
+    if (!indices.empty())
+    {
+        isSelected.assign(dataMatrix.rows(), 0);
+        for (int index : indices)
+            isSelected[index] = 1;
+    }
+
+#pragma omp parallel for
+    for (int c = 0; c < numCols; c++)
+    {
+        // only the stored non-zeros are visited, the implicit zeros all have the value -offset
+        const float zeroLevel = -offsets[c];
+        double columnSum = 0.0;
+        double columnSumSquares = 0.0;
+        float columnMin = std::numeric_limits<float>::max();
+        float columnMax = std::numeric_limits<float>::lowest();
+        int columnNonZeros = 0;
+
+        for (SparseDataMatrix::InnerIterator it(dataMatrix, c); it; ++it)
+        {
+            if (!isSelected.empty() && !isSelected[it.index()])
+                continue;
+
+            float value = it.value() + zeroLevel;
+            columnSum += value;
+            columnSumSquares += value * value;
+            columnMin = std::min(columnMin, value);
+            columnMax = std::max(columnMax, value);
+            columnNonZeros++;
+        }
+
+        const int numZeros = numPoints - columnNonZeros;
+        if (numZeros > 0)
+        {
+            columnSum += static_cast<double>(numZeros) * zeroLevel;
+            columnSumSquares += static_cast<double>(numZeros) * zeroLevel * zeroLevel;
+            columnMin = std::min(columnMin, zeroLevel);
+            columnMax = std::max(columnMax, zeroLevel);
+        }
+
+        stats.sum[c] = columnSum;
+        stats.sumSquares[c] = columnSumSquares;
+        stats.min[c] = numPoints > 0 ? columnMin : 0.0f;
+        stats.max[c] = numPoints > 0 ? columnMax : 0.0f;
+        stats.numNonZeros[c] = columnNonZeros;
+    }
+
+    return stats;
+}
+
+GeneStats computeGeneStats(const QuantizedMatrix& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::vector<int>& indices)
+{
+    GeneStats stats;
+    const int numCols = static_cast<int>(dataMatrix.cols());
+    const int numRows = static_cast<int>(dataMatrix.rows());
+    stats.resize(numCols, indices.empty() ? numRows : static_cast<int>(indices.size()));
+
+#pragma omp parallel
+    {
+        std::vector<float> decodedColumn(numRows);
+        std::vector<float> scratch;
+
+#pragma omp for
+        for (int c = 0; c < numCols; c++)
+        {
+            dataMatrix.decodeColumn(c, decodedColumn.data());
+
+            // a raw zero is stored with the same code as the zero level, so compare in the quantized domain
+            const float zeroLevel = dataMatrix.roundTrip(c, zeroLevels[c]);
+            const float* column = decodedColumn.data();
+            setColumnFromRows(stats, c, indices, numRows, zeroLevel, scratch, [column](int row) { return column[row]; });
+        }
+    }
+
+    return stats;
+}
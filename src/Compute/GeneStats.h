@@ -0,0 +1,84 @@
+#pragma once
+
+#include "DataMatrix.h"
+#include "QuantizedMatrix.h"
+
+/**
+ * Per-gene summary statistics over a set of points
+ *
+ * The statistics are of the stored (standardized) values. Non-zeros are counted against the zero level
+ * of each gene, i.e. the stored value of a raw zero, so they match the non-zeros of the raw expression
+ */
+struct GeneStats
+{
+    int                 numPoints = 0;
+    Eigen::VectorXf     sum;
+    Eigen::VectorXf     sumSquares;
+    Eigen::VectorXf     min;
+    Eigen::VectorXf     max;
+    Eigen::VectorXi     numNonZeros;
+
+    /** Reset to \p numGenes genes over \p numPoints points */
+    void resize(int numGenes, int numPoints);
+
+    /** Set the statistics of gene \p col from its \p numPoints values, different genes may be set in parallel */
+    void setColumn(int col, const float* values, float zeroLevel);
+
+    int getNumGenes() const { return sum.size(); }
+
+    Eigen::VectorXf mean() const { return sum / numPoints; }
+    Eigen::VectorXf variance() const { return (sumSquares / numPoints).array() - (sum / numPoints).array().square(); }
+};
+
+/**
+ * Running per-gene moments of the flood-fill, see DataSubset::updateFloodMoments()
+ *
+ * The sums are kept in double, so they survive many incremental updates. The cross moments with the positions
+ * of all axes (identified by positionKey) are only kept while the same positions are requested
+ */
+struct FloodMoments
+{
+    static constexpr int noPositions = -1;
+
+    int                 numPoints = 0;
+    Eigen::VectorXd     sum;
+    Eigen::VectorXd     sumSquares;
+    Eigen::MatrixXd     sumCross;             // genes x axes, sum of value * position
+    Eigen::VectorXd     positionSum;          // per axis
+    Eigen::VectorXd     positionSumSquares;   // per axis
+    int                 positionKey = noPositions;
+
+    int getNumGenes() const { return sum.size(); }
+    int getNumAxes() const { return positionKey == noPositions ? 0 : positionSum.size(); }
+
+    Eigen::VectorXf mean() const { return (sum / numPoints).cast<float>(); }
+
+    /** Pearson correlation of every gene with every position axis (genes x axes), 0 where undefined */
+    Eigen::MatrixXf positionCorrelation() const;
+};
+
+/**
+ * Per-wave aggregates of one flood-fill, see DataSubset::updateWaveLabelCounts()
+ *
+ * Row w holds the points of wave number w + 1, so the first waves of the flood-fill (nearest to the seed) are
+ * the last rows. Queries over waves cost O(waves x labels) instead of a rescan of the flood
+ */
+struct WaveAggregates
+{
+    Eigen::VectorXi     waveCounts;           // points per wave
+    Eigen::MatrixXi     labelCounts;          // waves x labels, points of every label per wave, empty until computed
+
+    int getNumWaves() const { return waveCounts.size(); }
+
+    /** Mean wave number of the points of every label, 0 for labels without points */
+    Eigen::VectorXf meanWaveNumberPerLabel() const;
+};
+
+/** Statistics of the rows \p indices of \p dataMatrix, all rows if \p indices is empty */
+GeneStats computeGeneStats(const DataMatrixRef& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::vector<int>& indices);
+
+/** Overloaded for sparse data with the standardized value _sparseData(i, j) - offsets[j], the zero level is -offsets */
+GeneStats computeGeneStats(const SparseDataMatrix& dataMatrix, const Eigen::VectorXf& offsets, const std::vector<int>& indices);
+
+/** Overloaded for quantized data, the values are dequantized on the fly */
+GeneStats computeGeneStats(const QuantizedMatrix& dataMatrix, const Eigen::VectorXf& zeroLevels, const std::vector<int>& indices);
@@ -0,0 +1,103 @@
+#include "MappedMatrix.h"
+
+#include <QDir>
+#include <QDebug>
+
+#include <utility>
+
+bool MappedMatrix::allocate(Eigen::Index rows, Eigen::Index cols)
+{
+    release();
+
+    const qint64 numBytes = static_cast<qint64>(rows) * static_cast<qint64>(cols) * static_cast<qint64>(sizeof(float));
+
+    _file = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/GeneSurfer_XXXXXX.bin");
+
+    if (!_file->open() || !_file->resize(numBytes))
+    {
+        qDebug() << "WARNING: MappedMatrix::allocate(): could not create backing file of" << numBytes << "bytes";
+        release();
+        return false;
+    }
+
+    // Mapping an empty file is not possible, an empty matrix needs no storage anyway
+    if (numBytes > 0)
+    {
+        uchar* mapped = _file->map(0, numBytes);
+        if (mapped == nullptr)
+        {
+            qDebug() << "WARNING: MappedMatrix::allocate(): could not map backing file" << _file->fileName();
+            release();
+            return false;
+        }
+        _data = reinterpret_cast<float*>(mapped);
+    }
+
+    _rows = rows;
+    _cols = cols;
+
+    return true;
+}
+
+bool MappedMatrix::mapFile(const QString& fileName, qint64 offset, Eigen::Index rows, Eigen::Index cols)
+{
+    release();
+
+    const qint64 numBytes = static_cast<qint64>(rows) * static_cast<qint64>(cols) * static_cast<qint64>(sizeof(float));
+
+    _file = std::make_unique<QFile>(fileName);
+
+    if (!_file->open(QFile::ReadOnly) || _file->size() < offset + numBytes)
+    {
+        qDebug() << "WARNING: MappedMatrix::mapFile(): could not open" << fileName;
+        release();
+        return false;
+    }
+
+    if (numBytes > 0)
+    {
+        uchar* mapped = _file->map(offset, numBytes, QFile::MapPrivateOption);
+        if (mapped == nullptr)
+        {
+            qDebug() << "WARNING: MappedMatrix::mapFile(): could not map" << fileName;
+            release();
+            return false;
+        }
+        _data = reinterpret_cast<float*>(mapped);
+    }
+
+    _rows = rows;
+    _cols = cols;
+
+    return true;
+}
+
+void MappedMatrix::release()
+{
+    if (_file)
+    {
+        if (_data != nullptr)
+            _file->unmap(reinterpret_cast<uchar*>(_data));
+        _file->close();
+        _file.reset(); // a QTemporaryFile removes the file on destruction
+    }
+
+    _data = nullptr;
+    _rows = 0;
+    _cols = 0;
+}
+
+MappedMatrix& MappedMatrix::operator=(MappedMatrix&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    release();
+
+    _file = std::move(other._file);
+    _data = std::exchange(other._data, nullptr);
+    _rows = std::exchange(other._rows, 0);
+    _cols = std::exchange(other._cols, 0);
+
+    return *this;
+}
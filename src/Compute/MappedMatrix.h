@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DataMatrix.h"
+
+#include <QTemporaryFile>
+
+#include <memory>
+
+/**
+ * Column-major float matrix backed by a memory-mapped file
+ *
+ * Every column is stored contiguously on disk, so a gene occupies its own run of pages
+ * and the OS page cache decides which genes stay resident
+ */
+class MappedMatrix
+{
+public:
+    MappedMatrix() = default;
+    ~MappedMatrix() { release(); }
+
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    // moving hands over the mapping, the backing file stays open
+    MappedMatrix(MappedMatrix&& other) noexcept { *this = std::move(other); }
+    MappedMatrix& operator=(MappedMatrix&& other) noexcept;
+
+    /** Create a temporary file of \p rows x \p cols floats and map it, returns false if the file could not be created or mapped */
+    bool allocate(Eigen::Index rows, Eigen::Index cols);
+
+    /**
+     * Map \p rows x \p cols floats at \p offset of the existing file \p fileName, returns false if it could not be mapped
+     * The mapping is private, writes to the matrix are never written back to the file
+     */
+    bool mapFile(const QString& fileName, qint64 offset, Eigen::Index rows, Eigen::Index cols);
+
+    /** Unmap and remove the backing file, mapped existing files are kept */
+    void release();
+
+    bool isValid() const { return _data != nullptr; }
+
+    Eigen::Index rows() const { return _rows; }
+    Eigen::Index cols() const { return _cols; }
+
+    /** Eigen view over the mapped pages */
+    DataMatrixMap getMap() { return DataMatrixMap(_data, _rows, _cols); }
+
+private:
+    std::unique_ptr<QFile>          _file;
+    float*                          _data = nullptr;
+    Eigen::Index                    _rows = 0;
+    Eigen::Index                    _cols = 0;
+};
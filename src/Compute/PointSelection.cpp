@@ -0,0 +1,84 @@
+#include "PointSelection.h"
+
+#include <algorithm>
+#include <bit>
+
+void PointSelection::resize(int numPoints)
+{
+    _numPoints = numPoints;
+
+    // assign() keeps the capacity, so reselecting does not allocate
+    _words.assign((static_cast<size_t>(numPoints) + bitsPerWord - 1) / bitsPerWord, Word(0));
+}
+
+bool PointSelection::assign(int numPoints, const std::vector<int>& indices)
+{
+    resize(numPoints);
+
+    bool inRange = true;
+    for (int index : indices)
+    {
+        if (index >= 0 && index < numPoints)
+            set(index);
+        else
+            inRange = false;
+    }
+
+    return inRange;
+}
+
+void PointSelection::assign(const std::vector<bool>& mask)
+{
+    resize(static_cast<int>(mask.size()));
+
+    for (int i = 0; i < _numPoints; i++)
+        if (mask[i])
+            set(i);
+}
+
+int PointSelection::count() const
+{
+    int numSelected = 0;
+    for (Word word : _words)
+        numSelected += std::popcount(word);
+
+    return numSelected;
+}
+
+PointSelection PointSelection::gather(const std::vector<int>& indices) const
+{
+    PointSelection gathered(static_cast<int>(indices.size()));
+
+    for (int i = 0; i < gathered._numPoints; i++)
+        if (test(indices[i]))
+            gathered.set(i);
+
+    return gathered;
+}
+
+std::vector<int> PointSelection::difference(const PointSelection& other) const
+{
+    std::vector<int> indices;
+
+    for (size_t w = 0; w < _words.size(); w++)
+    {
+        Word word = _words[w] & ~(w < other._words.size() ? other._words[w] : Word(0));
+        while (word != 0)
+        {
+            indices.push_back(static_cast<int>(w) * bitsPerWord + std::countr_zero(word));
+            word &= word - 1;
+        }
+    }
+
+    return indices;
+}
+
+std::vector<int> PointSelection::toIndices() const
+{
+    std::vector<int> indices;
+    indices.reserve(count());
+
+    forEach([&indices](int index) { indices.push_back(index); });
+
+    return indices;
+}
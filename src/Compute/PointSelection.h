@@ -0,0 +1,72 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Set of point indices stored as a dense bitmap, one bit per point
+ *
+ * Membership tests are a shift and a mask, the difference of two selections works on 64 points per instruction,
+ * so the points that entered or left the flood-fill cost numPoints / 64 word operations plus one per changed point
+ */
+class PointSelection
+{
+public:
+    using Word = uint64_t;
+    static constexpr int bitsPerWord = 64;
+
+    PointSelection() = default;
+    explicit PointSelection(int numPoints) { resize(numPoints); }
+
+    /** Reset to \p numPoints points, none of them selected */
+    void resize(int numPoints);
+
+    /** Select exactly \p indices out of \p numPoints points, returns false if any index is out of range (these are ignored) */
+    bool assign(int numPoints, const std::vector<int>& indices);
+
+    /** Select the points that are true in \p mask */
+    void assign(const std::vector<bool>& mask);
+
+    void clear() { _words.clear(); _numPoints = 0; }
+
+    int size() const { return _numPoints; }
+    bool empty() const { return _numPoints == 0; }
+
+    bool test(int index) const { return (_words[index / bitsPerWord] >> (index % bitsPerWord)) & Word(1); }
+    bool operator[](int index) const { return test(index); }
+
+    void set(int index) { _words[index / bitsPerWord] |= Word(1) << (index % bitsPerWord); }
+    void reset(int index) { _words[index / bitsPerWord] &= ~(Word(1) << (index % bitsPerWord)); }
+
+    /** Number of selected points */
+    int count() const;
+
+    /** Membership of the points \p indices, i.e. bit i of the result is test(indices[i]) */
+    PointSelection gather(const std::vector<int>& indices) const;
+
+    /** Points selected here but not in \p other in ascending order, one and-not per word */
+    std::vector<int> difference(const PointSelection& other) const;
+
+    /** Selected points in ascending order */
+    std::vector<int> toIndices() const;
+
+    /** Call \p func with every selected point in ascending order, skips empty words */
+    template<typename Func>
+    void forEach(Func func) const
+    {
+        for (int w = 0; w < static_cast<int>(_words.size()); w++)
+        {
+            Word word = _words[w];
+            while (word != 0)
+            {
+                func(w * bitsPerWord + std::countr_zero(word));
+                word &= word - 1;    // clear the lowest set bit
+            }
+        }
+    }
+
+private:
+    std::vector<Word>   _words;
+    int                 _numPoints = 0;
+};
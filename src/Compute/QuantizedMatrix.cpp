@@ -0,0 +1,111 @@
+#include "QuantizedMatrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+void QuantizedMatrix::resize(QuantizationType type, Eigen::Index rows, Eigen::Index cols)
+{
+    _type = type;
+    _rows = type == QuantizationType::NONE ? 0 : rows;
+    _cols = type == QuantizationType::NONE ? 0 : cols;
+
+    _halfData.resize(type == QuantizationType::FLOAT16 ? rows : 0, type == QuantizationType::FLOAT16 ? cols : 0);
+    _codeData.resize(type == QuantizationType::UINT8 ? rows : 0, type == QuantizationType::UINT8 ? cols : 0);
+    _scales.setZero(type == QuantizationType::UINT8 ? cols : 0);
+    _offsets.setZero(type == QuantizationType::UINT8 ? cols : 0);
+}
+
+void QuantizedMatrix::encodeColumn(int col, const float* column)
+{
+    Eigen::Map<const Eigen::VectorXf> src(column, _rows);
+
+    if (_type == QuantizationType::FLOAT16)
+    {
+        _halfData.col(col) = src.cast<Eigen::half>();
+        return;
+    }
+
+    if (_type != QuantizationType::UINT8 || _rows == 0)
+        return;
+
+    // Spread the range of the column over all 256 codes
+    float minValue = src.minCoeff();
+    float maxValue = src.maxCoeff();
+    float scale = (maxValue - minValue) / 255.0f;
+
+    _scales[col] = scale;
+    _offsets[col] = minValue;
+
+    if (scale <= 0)
+    {
+        _codeData.col(col).setZero();
+        return;
+    }
+
+    float invScale = 1.0f / scale;
+    uint8_t* codes = _codeData.col(col).data();
+    for (Eigen::Index i = 0; i < _rows; i++)
+        codes[i] = static_cast<uint8_t>(std::lround((column[i] - minValue) * invScale));
+}
+
+void QuantizedMatrix::decodeColumn(int col, float* column) const
+{
+    Eigen::Map<Eigen::VectorXf> dst(column, _rows);
+
+    if (_type == QuantizationType::FLOAT16)
+        dst = _halfData.col(col).cast<float>();
+    else if (_type == QuantizationType::UINT8)
+        dst = _codeData.col(col).cast<float>().array() * _scales[col] + _offsets[col];
+}
+
+float QuantizedMatrix::roundTrip(int col, float value) const
+{
+    if (_type == QuantizationType::FLOAT16)
+        return static_cast<float>(Eigen::half(value));
+
+    if (_type != QuantizationType::UINT8 || _scales[col] <= 0)
+        return _type == QuantizationType::UINT8 ? _offsets[col] : value;
+
+    // same rounding as encodeColumn()
+    float code = std::lround((value - _offsets[col]) * (1.0f / _scales[col]));
+    return std::clamp(code, 0.0f, 255.0f) * _scales[col] + _offsets[col];
+}
+
+void QuantizedMatrix::gatherRows(const std::vector<int>& indices, DataMatrix& denseMatrix) const
+{
+    std::vector<int> columns(_cols);
+    std::iota(columns.begin(), columns.end(), 0);
+
+    gatherRows(indices, columns, denseMatrix);
+}
+
+void QuantizedMatrix::gatherRows(const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& denseMatrix) const
+{
+    const int numRows = static_cast<int>(indices.size());
+    const int numCols = static_cast<int>(columns.size());
+
+    denseMatrix.resize(numRows, numCols);
+
+#pragma omp parallel for
+    for (int c = 0; c < numCols; c++)
+    {
+        const int col = columns[c];
+        float* dst = denseMatrix.col(c).data();
+
+        if (_type == QuantizationType::FLOAT16)
+        {
+            const Eigen::half* values = _halfData.col(col).data();
+            for (int i = 0; i < numRows; i++)
+                dst[i] = static_cast<float>(values[indices[i]]);
+        }
+        else
+        {
+            const uint8_t* codes = _codeData.col(col).data();
+            const float scale = _scales[col];
+            const float offset = _offsets[col];
+            for (int i = 0; i < numRows; i++)
+                dst[i] = codes[indices[i]] * scale + offset;
+        }
+    }
+}
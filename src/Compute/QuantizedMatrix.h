@@ -0,0 +1,60 @@
+#pragma once
+
+#include "DataMatrix.h"
+
+#include <cstdint>
+
+enum class QuantizationType
+{
+    NONE,
+    FLOAT16,
+    UINT8
+};
+
+/**
+ * Column-major matrix stored with reduced precision
+ *
+ * FLOAT16 stores half floats, UINT8 stores per-column affine codes with value = code * scale + offset.
+ * Values are only dequantized on the fly inside the kernels that read them
+ */
+class QuantizedMatrix
+{
+public:
+    /** Allocate \p rows x \p cols codes of \p type, NONE releases the storage */
+    void resize(QuantizationType type, Eigen::Index rows, Eigen::Index cols);
+    void release() { resize(QuantizationType::NONE, 0, 0); }
+
+    bool isValid() const { return _type != QuantizationType::NONE; }
+    QuantizationType getType() const { return _type; }
+
+    Eigen::Index rows() const { return _rows; }
+    Eigen::Index cols() const { return _cols; }
+
+    /** Encode the rows() values of \p column into column \p col, different columns may be encoded in parallel */
+    void encodeColumn(int col, const float* column);
+
+    /** Decode column \p col into the rows() values of \p column */
+    void decodeColumn(int col, float* column) const;
+
+    /** The decoded value that \p value would be stored as in column \p col */
+    float roundTrip(int col, float value) const;
+
+    /** Decode the rows \p indices of all columns into \p denseMatrix */
+    void gatherRows(const std::vector<int>& indices, DataMatrix& denseMatrix) const;
+
+    /** Decode the rows \p indices of only the \p columns into \p denseMatrix, column c of \p denseMatrix is column columns[c] */
+    void gatherRows(const std::vector<int>& indices, const std::vector<int>& columns, DataMatrix& denseMatrix) const;
+
+private:
+    using HalfMatrix = Eigen::Matrix<Eigen::half, -1, -1, Eigen::ColMajor>;
+    using CodeMatrix = Eigen::Matrix<uint8_t, -1, -1, Eigen::ColMajor>;
+
+    QuantizationType    _type = QuantizationType::NONE;
+    Eigen::Index        _rows = 0;
+    Eigen::Index        _cols = 0;
+
+    HalfMatrix          _halfData;
+    CodeMatrix          _codeData;
+    Eigen::VectorXf     _scales;      // UINT8 only
+    Eigen::VectorXf     _offsets;     // UINT8 only
+};
@@ -0,0 +1,65 @@
+#include "SliceIndex.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+void SliceIndex::build(int numPoints, int numSlices, const std::function<const std::vector<uint32_t>&(int slice)>& sliceIndices)
+{
+    clear();
+
+    _numPoints = numPoints;
+    _sliceOffsets.resize(numSlices + 1, 0);
+    for (int s = 0; s < numSlices; s++)
+        _sliceOffsets[s + 1] = _sliceOffsets[s] + static_cast<int>(sliceIndices(s).size());
+
+    _indices.resize(_sliceOffsets[numSlices]);
+    _sliceOfPoint.assign(numPoints, noSlice);
+    _localIndexOfPoint.assign(numPoints, -1);
+
+    int numOutOfRange = 0;
+    int numOverlapping = 0;
+
+    for (int s = 0; s < numSlices; s++)
+    {
+        const std::vector<uint32_t>& indices = sliceIndices(s);
+        int* sliceBegin = _indices.data() + _sliceOffsets[s];
+
+        std::copy(indices.begin(), indices.end(), sliceBegin);
+        std::sort(sliceBegin, sliceBegin + indices.size());
+
+        for (int local = 0; local < static_cast<int>(indices.size()); local++)
+        {
+            const int globalIndex = sliceBegin[local];
+            if (globalIndex < 0 || globalIndex >= numPoints)
+            {
+                numOutOfRange++;
+                continue;
+            }
+
+            if (_sliceOfPoint[globalIndex] != noSlice)
+            {
+                numOverlapping++;
+                continue;
+            }
+
+            _sliceOfPoint[globalIndex] = s;
+            _localIndexOfPoint[globalIndex] = local;
+        }
+    }
+
+    if (numOutOfRange > 0)
+        qDebug() << "WARNING: SliceIndex::build(): " << numOutOfRange << " slice indices are out of range of " << numPoints << " points";
+
+    if (numOverlapping > 0)
+        qDebug() << "WARNING: SliceIndex::build(): " << numOverlapping << " points are on more than one slice, they map back to their first slice";
+}
+
+void SliceIndex::clear()
+{
+    _numPoints = 0;
+    _sliceOffsets.clear();
+    _indices.clear();
+    _sliceOfPoint.clear();
+    _localIndexOfPoint.clear();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+/**
+ * Points of every slice of a slice (clusters) dataset, built once when the slices are set
+ *
+ * The points of all slices are stored in one flat array of ascending global indices per slice,
+ * every point maps back to its slice and its position within that slice.
+ * A point on several slices is listed in all of them, but maps back to the first one only
+ */
+class SliceIndex
+{
+public:
+    static constexpr int noSlice = -1;
+
+    /**
+     * Build the index of \p numSlices slices over \p numPoints points
+     * @param sliceIndices Returns the global point indices of one slice
+     */
+    void build(int numPoints, int numSlices, const std::function<const std::vector<uint32_t>&(int slice)>& sliceIndices);
+
+    void clear();
+
+    /** Only compares the sizes, the owner clears the index whenever the slices change */
+    bool isBuilt(int numPoints, int numSlices) const { return getNumSlices() == numSlices && _numPoints == numPoints && numSlices > 0; }
+
+    int getNumSlices() const { return _sliceOffsets.empty() ? 0 : static_cast<int>(_sliceOffsets.size()) - 1; }
+    int getNumPoints() const { return _numPoints; }
+
+    /** Global indices of the points of \p slice in ascending order, valid until the next build() */
+    std::span<const int> getSliceIndices(int slice) const
+    {
+        return std::span<const int>(_indices.data() + _sliceOffsets[slice], _sliceOffsets[slice + 1] - _sliceOffsets[slice]);
+    }
+
+    /** Slice of the point \p globalIndex, noSlice if it is on none, the first one if it is on several */
+    int getSlice(int globalIndex) const { return _sliceOfPoint[globalIndex]; }
+
+    /** Position of the point \p globalIndex in getSliceIndices(getSlice(globalIndex)) */
+    int getLocalIndex(int globalIndex) const { return _localIndexOfPoint[globalIndex]; }
+
+private:
+    int                 _numPoints = 0;
+    std::vector<int>    _sliceOffsets;          // start of every slice in _indices, plus the end
+    std::vector<int>    _indices;               // global indices of all slices
+    std::vector<int>    _sliceOfPoint;          // per point
+    std::vector<int>    _localIndexOfPoint;     // per point
+};
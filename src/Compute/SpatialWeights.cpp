@@ -0,0 +1,290 @@
+#include "SpatialWeights.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    /**
+     * Points binned into a uniform grid of cubic cells, the cells are sized for a few points each
+     * A query visits the cells in rings of growing Chebyshev distance around the cell of a point
+     */
+    class PointGrid
+    {
+    public:
+        PointGrid(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates) :
+            _coordinates{ &xCoordinates, &yCoordinates, zCoordinates.empty() ? nullptr : &zCoordinates }
+        {
+            const int numPoints = static_cast<int>(xCoordinates.size());
+            const int numDims = zCoordinates.empty() ? 2 : 3;
+
+            float extent[3] = { 0, 0, 0 };
+            double volume = 1.0;
+            int numActiveDims = 0;
+
+            for (int d = 0; d < numDims; d++)
+            {
+                const auto [minIt, maxIt] = std::minmax_element(_coordinates[d]->begin(), _coordinates[d]->end());
+                _min[d] = *minIt;
+                extent[d] = *maxIt - *minIt;
+
+                if (extent[d] > 0)
+                {
+                    volume *= extent[d];
+                    numActiveDims++;
+                }
+            }
+
+            // about pointsPerCell points per cell if the points were spread evenly, the number of cells is capped in case they are not
+            constexpr double pointsPerCell = 2.0;
+            _cellSize = numActiveDims == 0 ? 1.0f : static_cast<float>(std::pow(volume * pointsPerCell / numPoints, 1.0 / numActiveDims));
+
+            const int64_t maxNumCells = 4 * static_cast<int64_t>(numPoints) + 1;
+            int64_t numCells = 0;
+            do
+            {
+                numCells = 1;
+                for (int d = 0; d < 3; d++)
+                {
+                    _numCells[d] = d < numDims ? static_cast<int>(extent[d] / _cellSize) + 1 : 1;
+                    numCells *= _numCells[d];
+                }
+
+                if (numCells > maxNumCells)
+                    _cellSize *= 1.5f;
+            } while (numCells > maxNumCells);
+
+            // counting sort of the points by cell
+            _cellOfPoint.resize(numPoints);
+            _cellStart.assign(numCells + 1, 0);
+            for (int i = 0; i < numPoints; i++)
+            {
+                int cell[3];
+                cellOf(i, cell);
+                _cellOfPoint[i] = cellIndex(cell[0], cell[1], cell[2]);
+                _cellStart[_cellOfPoint[i] + 1]++;
+            }
+
+            for (int64_t c = 0; c < numCells; c++)
+                _cellStart[c + 1] += _cellStart[c];
+
+            _cellPoints.resize(numPoints);
+            std::vector<int> next(_cellStart.begin(), _cellStart.end() - 1);
+            for (int i = 0; i < numPoints; i++)
+                _cellPoints[next[_cellOfPoint[i]]++] = i;
+        }
+
+        float getCellSize() const { return _cellSize; }
+
+        /** Largest ring that can contain any point */
+        int getMaxRing() const { return std::max({ _numCells[0], _numCells[1], _numCells[2] }) - 1; }
+
+        float squaredDistance(int i, int j) const
+        {
+            float distance = 0;
+            for (int d = 0; d < 3 && _coordinates[d] != nullptr; d++)
+            {
+                const float diff = (*_coordinates[d])[i] - (*_coordinates[d])[j];
+                distance += diff * diff;
+            }
+            return distance;
+        }
+
+        /** Call \p func with every point in the cells at Chebyshev distance \p ring from the cell of point \p i */
+        template<typename Func>
+        void forEachInRing(int i, int ring, Func func) const
+        {
+            int cell[3];
+            cellOf(i, cell);
+
+            int lo[3];
+            int hi[3];
+            for (int d = 0; d < 3; d++)
+            {
+                lo[d] = std::max(0, cell[d] - ring);
+                hi[d] = std::min(_numCells[d] - 1, cell[d] + ring);
+            }
+
+            for (int cz = lo[2]; cz <= hi[2]; cz++)
+                for (int cy = lo[1]; cy <= hi[1]; cy++)
+                    for (int cx = lo[0]; cx <= hi[0]; cx++)
+                    {
+                        // the inner cells belong to smaller rings
+                        if (std::max({ std::abs(cx - cell[0]), std::abs(cy - cell[1]), std::abs(cz - cell[2]) }) != ring)
+                            continue;
+
+                        const int64_t c = cellIndex(cx, cy, cz);
+                        for (int k = _cellStart[c]; k < _cellStart[c + 1]; k++)
+                            func(_cellPoints[k]);
+                    }
+        }
+
+    private:
+        void cellOf(int i, int cell[3]) const
+        {
+            for (int d = 0; d < 3; d++)
+                cell[d] = _coordinates[d] == nullptr ? 0 : std::clamp(static_cast<int>(((*_coordinates[d])[i] - _min[d]) / _cellSize), 0, _numCells[d] - 1);
+        }
+
+        int64_t cellIndex(int cx, int cy, int cz) const
+        {
+            return (static_cast<int64_t>(cz) * _numCells[1] + cy) * _numCells[0] + cx;
+        }
+
+    private:
+        const std::vector<float>*   _coordinates[3];
+        float                       _min[3] = { 0, 0, 0 };
+        float                       _cellSize = 1.0f;
+        int                         _numCells[3] = { 1, 1, 1 };
+        std::vector<int>            _cellStart;         // first entry of every cell in _cellPoints, plus the end
+        std::vector<int>            _cellPoints;        // points sorted by cell
+        std::vector<int64_t>        _cellOfPoint;
+    };
+
+    using Neighbors = std::vector<std::pair<int, float>>;  // point and squared distance
+
+    // the k nearest other points of point i, coinciding points are skipped
+    void findNearest(const PointGrid& grid, int i, int k, Neighbors& nearest)
+    {
+        nearest.clear();
+
+        auto farther = [](const std::pair<int, float>& a, const std::pair<int, float>& b) { return a.second < b.second; };
+
+        for (int ring = 0; ring <= grid.getMaxRing(); ring++)
+        {
+            grid.forEachInRing(i, ring, [&](int j) {
+                const float distance = grid.squaredDistance(i, j);
+                if (j == i || distance == 0)
+                    return;
+
+                if (static_cast<int>(nearest.size()) < k)
+                {
+                    nearest.emplace_back(j, distance);
+                    std::push_heap(nearest.begin(), nearest.end(), farther);
+                }
+                else if (distance < nearest.front().second)
+                {
+                    std::pop_heap(nearest.begin(), nearest.end(), farther);
+                    nearest.back() = { j, distance };
+                    std::push_heap(nearest.begin(), nearest.end(), farther);
+                }
+            });
+
+            // the points of the next rings are at least ring * cellSize away
+            const float reach = ring * grid.getCellSize();
+            if (static_cast<int>(nearest.size()) == k && nearest.front().second <= reach * reach)
+                break;
+        }
+    }
+
+    // all other points of point i within radius, coinciding points are skipped
+    void findWithinRadius(const PointGrid& grid, int i, float radius, Neighbors& neighbors)
+    {
+        neighbors.clear();
+
+        const float radiusInCells = std::ceil(radius / grid.getCellSize());
+        const int maxRing = radiusInCells < grid.getMaxRing() ? static_cast<int>(radiusInCells) : grid.getMaxRing();
+        const float squaredRadius = radius * radius;
+
+        for (int ring = 0; ring <= maxRing; ring++)
+        {
+            grid.forEachInRing(i, ring, [&](int j) {
+                const float distance = grid.squaredDistance(i, j);
+                if (j != i && distance > 0 && distance <= squaredRadius)
+                    neighbors.emplace_back(j, distance);
+            });
+        }
+    }
+
+    float meanNearestDistance(const PointGrid& grid, int numPoints)
+    {
+        double sum = 0.0;
+        int count = 0;
+
+#pragma omp parallel
+        {
+            Neighbors nearest;
+
+#pragma omp for reduction(+:sum, count)
+            for (int i = 0; i < numPoints; i++)
+            {
+                findNearest(grid, i, 1, nearest);
+                if (!nearest.empty())
+                {
+                    sum += std::sqrt(nearest.front().second);
+                    count++;
+                }
+            }
+        }
+
+        return count > 0 ? static_cast<float>(sum / count) : 0.0f;
+    }
+}
+
+SpatialWeightMatrix computeSpatialWeights(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates, const SpatialWeightSettings& settings)
+{
+    const int numPoints = static_cast<int>(xCoordinates.size());
+
+    if (yCoordinates.size() != xCoordinates.size() || (!zCoordinates.empty() && zCoordinates.size() != xCoordinates.size()))
+    {
+        qDebug() << "ERROR: computeSpatialWeights(): coordinates of different sizes";
+        return SpatialWeightMatrix();
+    }
+
+    SpatialWeightMatrix weights(numPoints, numPoints);
+    if (numPoints == 0)
+        return weights;
+
+    const PointGrid grid(xCoordinates, yCoordinates, zCoordinates);
+
+    const int numNeighbors = std::clamp(settings.numNeighbors, 1, std::max(1, numPoints - 1));
+    const float radius = settings.type == SpatialWeightType::RADIUS ? settings.radiusFactor * meanNearestDistance(grid, numPoints) : 0.0f;
+
+    // the inverse distance weights of every row, sorted by column
+    std::vector<Neighbors> rows(numPoints);
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numPoints; i++)
+    {
+        Neighbors& neighbors = rows[i];
+
+        if (settings.type == SpatialWeightType::K_NEAREST)
+            findNearest(grid, i, numNeighbors, neighbors);
+        else if (settings.type == SpatialWeightType::RADIUS)
+            findWithinRadius(grid, i, radius, neighbors);
+        else
+            findWithinRadius(grid, i, std::numeric_limits<float>::max(), neighbors);
+
+        std::sort(neighbors.begin(), neighbors.end());
+
+        float rowSum = 0.0f;
+        for (auto& [j, weight] : neighbors)
+        {
+            weight = 1.0f / std::sqrt(weight);
+            rowSum += weight;
+        }
+        for (auto& neighbor : neighbors)
+            neighbor.second /= rowSum;
+    }
+
+    Eigen::VectorXi nonZerosPerRow(numPoints);
+    for (int i = 0; i < numPoints; i++)
+        nonZerosPerRow[i] = static_cast<int>(rows[i].size());
+
+    weights.reserve(nonZerosPerRow);
+    for (int i = 0; i < numPoints; i++)
+    {
+        for (const auto& [j, weight] : rows[i])
+            weights.insert(i, j) = weight;
+
+        Neighbors().swap(rows[i]);
+    }
+    weights.makeCompressed();
+
+    return weights;
+}
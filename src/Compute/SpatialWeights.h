@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Eigen/Sparse>
+
+#include <vector>
+
+using SpatialWeightMatrix = Eigen::SparseMatrix<float, Eigen::RowMajor, int>;  // compressed sparse rows, one row per point
+
+enum class SpatialWeightType
+{
+    ALL_PAIRS,      // inverse distance to every other point, dense
+    K_NEAREST,      // inverse distance to the k nearest neighbours
+    RADIUS          // inverse distance to the neighbours within a radius
+};
+
+/** All pairs is the default since the neighbourhood weights give different Moran's I scores, they are opt-in for large floods */
+struct SpatialWeightSettings
+{
+    SpatialWeightType   type = SpatialWeightType::ALL_PAIRS;
+    int                 numNeighbors = 8;
+    float               radiusFactor = 2.0f;  // radius as multiple of the mean nearest-neighbour distance, so it does not depend on the position units
+};
+
+/**
+ * Row-normalized inverse-distance weights between the neighbouring points \p xCoordinates, \p yCoordinates and \p zCoordinates (empty for 2D)
+ *
+ * The neighbours are found with a uniform grid over the points, so building the weights costs about N * k
+ * instead of N^2 and only the non-zero weights are stored. Coinciding points get no weight, as in the dense weights
+ */
+SpatialWeightMatrix computeSpatialWeights(const std::vector<float>& xCoordinates, const std::vector<float>& yCoordinates, const std::vector<float>& zCoordinates, const SpatialWeightSettings& settings);
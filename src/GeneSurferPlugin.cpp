@@ -8,14 +8,17 @@
 #include <util/Serialization.h>
 
 #include <vector>
+#include <numeric>
 #include <random>
 #include <set>
+#include <span>
 #include <unordered_map>
 
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
 #include "Compute/DataTransformations.h"
+#include "Compute/GeneSelection.h"
 
 #include <QString>
 #include <QStringList>
@@ -25,6 +28,8 @@
 #include <QMimeData>
 #include <QDebug>
 #include <QSplitter>
+#include <QtConcurrent>
+#include <QTimer>
 #include <QMessageBox>
 
 // for reading hard-coded csv files
@@ -96,6 +101,7 @@ GeneSurferPlugin::GeneSurferPlugin(const PluginFactory* factory) :
     _primaryToolbarAction.addAction(&_settingsAction.getDimensionSelectionAction(), 2, GroupAction::Horizontal);
     _primaryToolbarAction.addAction(&_settingsAction.getCorrelationModeAction(), -1, GroupAction::Horizontal);
     _primaryToolbarAction.addAction(&_settingsAction.getSingleCellModeAction());
+    _primaryToolbarAction.addAction(&_settingsAction.getStorageAction());
 
     _secondaryToolbarAction.addAction(&_settingsAction.getEnrichmentAction());
 
@@ -142,6 +148,12 @@ void GeneSurferPlugin::init()
     _filterLabel->setFont(sansFont);   
     _filterLabel->setGeometry(10, 10, 400, 30);
     _filterLabel->setText("Filter genes by:" + _corrFilter.getCorrFilterTypeAsString());
+
+    // Add label for the progress of loading the data below the filter label
+    _statusLabel = new QLabel(_chartWidget);
+    _statusLabel->setFont(sansFont);
+    _statusLabel->setGeometry(10, 40, 400, 30);
+    _statusLabel->hide();
     
     _tableWidget = new MyTableWidget();
 
@@ -286,9 +298,29 @@ void GeneSurferPlugin::init()
     // Load points when the pointer to the position dataset changes
     connect(&_positionDataset, &Dataset<Points>::changed, this, &GeneSurferPlugin::positionDatasetChanged);
 
+    // the slice index is rebuilt for new slices and for edited clusters of the same slice dataset
+    connect(&_sliceDataset, &Dataset<Clusters>::changed, this, [this]() { _sliceIndex.clear(); });
+    connect(&_sliceDataset, &Dataset<Clusters>::dataChanged, this, [this]() { _sliceIndex.clear(); });
+
+    // Data is loaded in the background
+    connect(&_ingestWatcher, &QFutureWatcher<bool>::finished, this, &GeneSurferPlugin::finishIngestion);
+    connect(&_rankWatcher, &QFutureWatcher<bool>::finished, this, &GeneSurferPlugin::finishRanking);
+    connect(&_ingestWatcher, &QFutureWatcher<bool>::progressValueChanged, this, [this, lastReported = -1](int progress) mutable {
+        updateStatusLabel(QString("Loading data: %1%").arg(progress));
+
+        if (progress / 10 == lastReported / 10)
+            return;
+        lastReported = progress;
+        qDebug() << "GeneSurferPlugin: converting dataset " << progress << "%";
+        });
+
     // update data when data set changed
     //connect(&_positionDataset, &Dataset<Points>::dataChanged, this, &GeneSurferPlugin::convertDataAndUpdateChart);
 
+    // the cache key only samples the values, so the cached base data is removed explicitly once they are edited
+    connect(&_positionDataset, &Dataset<Points>::dataChanged, this, [this]() { removeDataCacheFile(_dataStore.getCacheFilePath()); });
+    connect(&_positionSourceDataset, &Dataset<Points>::dataChanged, this, [this]() { removeDataCacheFile(_dataStore.getCacheFilePath()); });
+
     // Update the selection from JS
     connect(&_chartWidget->getCommunicationObject(), &ChartCommObject::passSelectionToCore, this, &GeneSurferPlugin::publishSelection);
 
@@ -304,7 +336,7 @@ void GeneSurferPlugin::init()
             _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex);
         }
         else {
-            _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _onSliceIndices, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
+            _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _onSliceIndices, _onSliceMask, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
         }      
         updateSelection();
         });
@@ -331,7 +363,7 @@ void GeneSurferPlugin::init()
         else 
         {
             //qDebug() << "Before computeSubset 3D";
-            _computeSubset.updateSelectedData(_positionDataset, selection, _onSliceIndices, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices); 
+            _computeSubset.updateSelectedData(_positionDataset, selection, _onSliceIndices, _onSliceMask, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices); 
             // TODO check if _onSliceFloodIndices is needed
             /*qDebug() << "_sortedFloodIndices.size = " << _sortedFloodIndices.size();
             qDebug() << "_onSliceFloodIndices.size = " << _onSliceFloodIndices.size();*/
@@ -369,6 +401,8 @@ void GeneSurferPlugin::positionDatasetChanged()
     _positionSourceDataset = _positionDataset->getSourceDataset<Points>();
 
     _numPoints = _positionDataset->getNumPoints();
+    _spatialAxes.resize(0, 0);
+    _corrFilter.getMoranFilter().clearWeightCache();
 
     // Get enabled dimension names
     const auto& dimNames = _positionSourceDataset->getDimensionNames();
@@ -396,20 +430,207 @@ void GeneSurferPlugin::positionDatasetChanged()
     }
 
     qDebug() << "GeneSurferPlugin::positionDatasetChanged(): start converting dataset ... ";
-    convertToEigenMatrix(_positionDataset, _positionSourceDataset, _dataStore.getBaseData());
-    convertToEigenMatrixProjection(_positionDataset, _dataStore.getBaseFullProjection());
 
-    standardizeData(_dataStore.getBaseData(), _dataStore.getVariances()); // getBaseData() is standardized here TO DO: temporarily disabled
-    //normalizeDataEigen(_dataStore.getBaseData(), _dataStore.getBaseNormalizedData());TO DO: getBaseData() or getBaseNormalizedData()
-    qDebug() << "GeneSurferPlugin::positionDatasetChanged(): finish converting dataset ... ";
+    _dataInitialized = false;
 
-    _dataStore.createDataView();
-    updateSelectedDim();
+    startIngestion();
+}
+
+void GeneSurferPlugin::startIngestion(bool useCache)
+{
+    // a second drop or storage change aborts the load that is still running
+    cancelIngestion();
+
+    // the data is ingested into a separate storage, so the current one stays untouched until the new one is complete
+    _stagedDataStore = std::make_shared<DataStorage>();
+    applyStorageSettings(*_stagedDataStore);
+    if (!useCache)
+        _stagedDataStore->setCacheEnabled(false);
+
+    updateStatusLabel("Loading data ...");
+
+    // everything that is read from the datasets and their actions is copied here on the GUI thread,
+    // the background ingestion only works on this plain data and never touches a dataset
+    auto source = std::make_shared<IngestionSource>(_stagedDataStore->prepareIngestion(_positionDataset, _positionSourceDataset));
+    auto stagedDataStore = _stagedDataStore;
+    const bool rankData = !_isSingleCell && _corrFilter.getFilterType() == corrFilter::CorrFilterType::WILCOXON;
+
+    _ingestWatcher.setFuture(QtConcurrent::run([stagedDataStore, source, rankData](QPromise<bool>& promise) {
+        promise.setProgressRange(0, 100);
+
+        // getBaseData() is standardized here
+        bool completed = stagedDataStore->ingestData(*source, [&promise](int numDone, int numTotal) {
+            promise.setProgressValue(numTotal > 0 ? 100 * numDone / numTotal : 100);
+            return !promise.isCanceled();
+            });
+
+        // the rank filter is active, so its ranks are needed right away instead of being computed on first use
+        if (completed && rankData)
+        {
+            GeneRanks ranks;
+            completed = stagedDataStore->computeBaseRanks(ranks, [&promise]() { return !promise.isCanceled(); });
+            stagedDataStore->setBaseRanks(std::move(ranks));
+        }
+
+        if (completed)
+            promise.setProgressValue(100);
 
-    updateFloodFillDataset();
+        promise.addResult(completed);
+        }));
 
+    // the rest of a project is restored right after this, so it needs the data immediately
+    if (_loadingFromProject)
+    {
+        _ingestWatcher.waitForFinished();
+        finishIngestion();
+    }
+}
+
+void GeneSurferPlugin::finishIngestion()
+{
+    // nothing staged: already finished while loading a project, or cancelled
+    if (!_stagedDataStore || !_ingestWatcher.isFinished())
+        return;
+
+    auto stagedDataStore = std::move(_stagedDataStore);
+
+    if (_ingestWatcher.isCanceled())
+    {
+        qDebug() << "GeneSurferPlugin::finishIngestion(): converting dataset cancelled";
+        updateStatusLabel("Loading data cancelled");
+        return;
+    }
+
+    // not cancelled, so the cache file that was expected could not be read, its raw values were not copied
+    if (_ingestWatcher.future().resultCount() == 0 || !_ingestWatcher.result())
+    {
+        qDebug() << "GeneSurferPlugin::finishIngestion(): converting dataset from the cache failed, converting it again without the cache";
+        startIngestion(false);
+        return;
+    }
+
+    updateStatusLabel({});
+
+    // only a storage change re-ingests the data while the previous data is in use
+    const bool isStorageChange = _dataInitialized;
+
+    // a running ranking reads the storage that is replaced now, it is restarted on the new data when needed
+    cancelRanking();
+    updateFilterLabel();
+
+    _dataStore = std::move(*stagedDataStore);
+    qDebug() << "GeneSurferPlugin::finishIngestion(): finish converting dataset ... ";
+
+    _computeSubset.invalidateFloodMoments();
+
+    // the view of the current slice is kept, see updateSlice()
+    if (_sliceDataset.isValid() && !_onSliceIndices.empty())
+        _dataStore.createDataView(_onSliceIndices);
+    else
+        _dataStore.createDataView();
+    updateSelectedDim();
+
+    // set before the selection update, which computes the selection on the new data
     _dataInitialized = true;
 
+    // the scores of the current selection are recomputed from the new storage
+    if (isStorageChange)
+        updateSelection();
+    else
+        updateFloodFillDataset();
+}
+
+void GeneSurferPlugin::cancelIngestion()
+{
+    if (_ingestWatcher.isRunning())
+    {
+        qDebug() << "GeneSurferPlugin::cancelIngestion(): cancelling the running conversion ... ";
+        _ingestWatcher.cancel();
+        _ingestWatcher.waitForFinished();
+    }
+
+    _stagedDataStore.reset();
+}
+
+void GeneSurferPlugin::startRanking()
+{
+    if (_rankWatcher.isRunning())
+        return;
+
+    _pendingRanks = std::make_shared<GeneRanks>();
+
+    auto pendingRanks = _pendingRanks;
+    DataStorage* dataStore = &_dataStore;
+
+    qDebug() << "GeneSurferPlugin::startRanking(): ranking genes in the background ... ";
+
+    // _dataStore is only replaced by finishIngestion(), which cancels the ranking first
+    _rankWatcher.setFuture(QtConcurrent::run([dataStore, pendingRanks](QPromise<bool>& promise) {
+        promise.addResult(dataStore->computeBaseRanks(*pendingRanks, [&promise]() { return !promise.isCanceled(); }));
+        }));
+
+    updateFilterLabel();
+}
+
+void GeneSurferPlugin::finishRanking()
+{
+    // nothing pending: cancelled
+    if (!_pendingRanks || !_rankWatcher.isFinished())
+        return;
+
+    auto pendingRanks = std::move(_pendingRanks);
+    updateFilterLabel();
+
+    if (_rankWatcher.isCanceled() || _rankWatcher.future().resultCount() == 0 || !_rankWatcher.result())
+    {
+        qDebug() << "GeneSurferPlugin::finishRanking(): ranking genes cancelled";
+        return;
+    }
+
+    _dataStore.setBaseRanks(std::move(*pendingRanks));
+    qDebug() << "GeneSurferPlugin::finishRanking(): finish ranking genes ... ";
+
+    // the selection was not scored while the ranks were missing
+    if (_corrFilter.getFilterType() == corrFilter::CorrFilterType::WILCOXON)
+        updateSelection();
+}
+
+void GeneSurferPlugin::cancelRanking()
+{
+    if (_rankWatcher.isRunning())
+    {
+        _rankWatcher.cancel();
+        _rankWatcher.waitForFinished();
+    }
+
+    _pendingRanks.reset();
+}
+
+void GeneSurferPlugin::applyStorageSettings(DataStorage& dataStore)
+{
+    const auto quantization = static_cast<QuantizationType>(_settingsAction.getStorageAction().getPrecisionAction().getCurrentIndex());
+
+    // the out-of-core toggle is disabled while quantizing, a checked toggle restored from a project does not apply either
+    dataStore.setOutOfCore(quantization == QuantizationType::NONE && _settingsAction.getStorageAction().getOutOfCoreAction().isChecked());
+    dataStore.setQuantization(quantization);
+    dataStore.setCacheEnabled(_settingsAction.getStorageAction().getCacheAction().isChecked());
+}
+
+void GeneSurferPlugin::updateStorageMode()
+{
+    if (!_positionDataset.isValid() || !_positionSourceDataset.isValid() || _storageChangePending)
+        return;
+
+    // the storage actions restored from a project change one after the other, they are re-ingested together once
+    _storageChangePending = true;
+    QTimer::singleShot(0, this, [this]() {
+        _storageChangePending = false;
+
+        qDebug() << "GeneSurferPlugin::updateStorageMode(): out-of-core " << _settingsAction.getStorageAction().getOutOfCoreAction().isChecked() << ", precision " << _settingsAction.getStorageAction().getPrecisionAction().getCurrentText();
+
+        // the current data stays in use until the new storage is complete, finishIngestion() then recomputes the selection
+        startIngestion();
+        });
 }
 
 void GeneSurferPlugin::convertDataAndUpdateChart()
@@ -437,32 +658,42 @@ void GeneSurferPlugin::convertDataAndUpdateChart()
     "#9D755D"  // brown
     };
 
-    // only process genes present in _dimNameToClusterLabel
-    std::vector<std::pair<QString, float>> filteredAndSortedGenes;
+    // permutation p-values of Moran's I, if they were computed for the current genes
+    const std::vector<float>& pValues = _corrFilter.getMoranFilter().getPermutationPValues();
+    const bool hasPValues = _corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN && pValues.size() == _corrGeneVector.size();
 
-    for (size_t i = 0; i < _enabledDimNames.size(); ++i) {
-        if (_dimNameToClusterLabel.find(_enabledDimNames[i]) != _dimNameToClusterLabel.end()) {
-            filteredAndSortedGenes.emplace_back(_enabledDimNames[i], _corrGeneVector[i]);
-        }
+    // only the clustered genes are charted, sorted by their correlation values
+    const int numFilteredGenes = static_cast<int>(_filteredGeneIndices.size());
+    if (numFilteredGenes > 0 && *std::max_element(_filteredGeneIndices.begin(), _filteredGeneIndices.end()) >= static_cast<int>(std::min(_enabledDimNames.size(), _corrGeneVector.size()))) {
+        qDebug() << "GeneSurferPlugin::convertDataAndUpdateChart: clustered genes are out of date";
+        return;
     }
 
-    // Sort the filtered genes by their correlation values
-    std::sort(filteredAndSortedGenes.begin(), filteredAndSortedGenes.end(),
-         [](const std::pair<QString, float>& a, const std::pair<QString, float>& b) {
-                return a.second < b.second;
-         });
+    std::vector<float> filteredValues(numFilteredGenes);
+    for (int i = 0; i < numFilteredGenes; ++i)
+        filteredValues[i] = _corrGeneVector[_filteredGeneIndices[i]];
+
+    std::vector<int> chartOrder(numFilteredGenes);
+    std::iota(chartOrder.begin(), chartOrder.end(), 0);
+    sortGenesByScore(filteredValues, chartOrder);
 
     // convert data to a JSON structure
     QVariantList payload;
-    for (const auto& genePair : filteredAndSortedGenes) {
+    payload.reserve(numFilteredGenes);
+    for (int i : chartOrder) {
+        const int geneIndex = _filteredGeneIndices[i];
+
         QVariantMap entry;
-        entry["Gene"] = genePair.first;
-        entry["Value"] = genePair.second;
+        entry["Gene"] = _enabledDimNames[geneIndex];
+        entry["Value"] = filteredValues[i];
 
-        int clusterLabel = _dimNameToClusterLabel[genePair.first];
+        int clusterLabel = _filteredGeneLabels[i];
         entry["categoryColor"] = plotlyT10Palette[clusterLabel % plotlyT10Palette.size()];
         entry["cluster"] = "Gene cluster " + QString::number(clusterLabel);
 
+        if (hasPValues)
+            entry["PValue"] = pValues[geneIndex];
+
         payload.push_back(entry);
     }
 
@@ -470,6 +701,8 @@ void GeneSurferPlugin::convertDataAndUpdateChart()
     payloadMap["data"] = payload;
     if (_corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN)
         payloadMap["FilterType"] = "Moran";
+    else if (_corrFilter.getFilterType() == corrFilter::CorrFilterType::WILCOXON && !_isSingleCell)
+        payloadMap["FilterType"] = "Wilcoxon";
     else 
         payloadMap["FilterType"] = "Others";
 
@@ -529,7 +762,7 @@ void GeneSurferPlugin::updateFloodFillDataset()
         _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex);
     }
     else {
-        _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _onSliceIndices, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
+        _computeSubset.updateFloodFill(_floodFillDataset, _numPoints, _onSliceIndices, _onSliceMask, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
     }
 
     updateSelection();
@@ -748,6 +981,8 @@ void GeneSurferPlugin::loadLabelsFromSTDataset() {
     // precompute the cell-label array
     _cellLabels.clear();
     _cellLabels.resize(_numPoints);
+    _cellLabelRows.assign(_numPoints, -1);
+    _computeSubset.invalidateWaveLabelCounts();
 
     int numClustersNotInST = 0;
 
@@ -762,6 +997,7 @@ void GeneSurferPlugin::loadLabelsFromSTDataset() {
                 for (int j = 0; j < ptIndices.size(); ++j) {
                     int ptIndex = ptIndices[j];
                     _cellLabels[ptIndex] = clusterName;
+                    _cellLabelRows[ptIndex] = i;
                 }
                 // add weighting for each cluster of whole data
                 _countsAll[i] = ptIndices.size(); // number of pt in each cluster
@@ -815,9 +1051,9 @@ void GeneSurferPlugin::updateEnrichmentAPI()
     _currentEnrichmentAPI = _settingsAction.getEnrichmentAction().getEnrichmentAPIPickerAction().getCurrentText();
     qDebug() << "Enrichment API changed to: " << _currentEnrichmentAPI;
     
-    if (_dimNameToClusterLabel.size() == 0)
+    if (_filteredGeneIndices.empty())
         {
-        qDebug() << "GeneSurferPlugin::updateEnrichmentAPI(): _dimNameToClusterLabel is empty";
+        qDebug() << "GeneSurferPlugin::updateEnrichmentAPI(): no clustered genes";
         return;
     }
 
@@ -862,7 +1098,7 @@ void GeneSurferPlugin::updateSelection()
     // clear table content
     _tableWidget->clearContents(); 
 
-    if (!_positionDataset.isValid())
+    if (!_positionDataset.isValid() || !_dataInitialized)
         return;
 
     if (_isFloodIndex.empty()) {
@@ -876,21 +1112,8 @@ void GeneSurferPlugin::updateSelection()
     ////////////////////
     // Compute subset //
     ////////////////////
-    if (!_isSingleCell && !_sliceDataset.isValid()) {
-        qDebug() << "Compute subset: 2D + ST";
-        _computeSubset.computeSubsetData(_dataStore.getBaseData(), _sortedFloodIndices, _subsetData);
-    }
-    if (!_isSingleCell && _sliceDataset.isValid()) {
-        qDebug() << "Compute subset: 3D + ST";
-        //subset data only contains the onSliceFloodIndice
-        //qDebug() << "GeneSurferPlugin::updateSelection(): _onSliceFloodIndices size: " << _onSliceFloodIndices.size();
-        _computeSubset.computeSubsetData(_dataStore.getBaseData(), _onSliceFloodIndices, _subsetData); //TODO: check if needed
-        //qDebug() << "GeneSurferPlugin::updateSelection(): _subsetData size: " << _subsetData.rows() << " " << _subsetData.cols();
-        //subset data contains all floodfill indices     
-        //qDebug() << "GeneSurferPlugin::updateSelection(): _sortedFloodIndices size: " << _sortedFloodIndices.size();
-        _computeSubset.computeSubsetData(_dataStore.getBaseData(), _sortedFloodIndices, _subsetData3D);
-        //qDebug() << "GeneSurferPlugin::updateSelection(): _subsetData3D size: " << _subsetData3D.rows() << " " << _subsetData3D.cols();
-    }
+    // ST: no subset of all genes is built here, Diff and SpatialCorr reduce the base data directly (see updateFloodMoments()),
+    // Moran gathers the flood for itself and clusterGenes() gathers only the filtered genes
     if (_isSingleCell && !_sliceDataset.isValid()) {
         qDebug() << "Compute subset: 2D + SingleCell";
         countLabelDistribution();
@@ -914,13 +1137,29 @@ void GeneSurferPlugin::updateSelection()
     // -------------- Diff --------------
     if (!_isSingleCell && !_sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::DIFF) {
         qDebug() << "Compute filtering: 2D + ST + Diff";
-        _corrFilter.getDiffFilter().computeDiff(_subsetData, _dataStore.getBaseData(), _corrGeneVector);
+        // only the points that entered or left the flood since the last update are read
+        updateFloodMoments(DataMatrix(), FloodMoments::noPositions);
+        _corrFilter.getDiffFilter().computeDiff(_computeSubset.getFloodMoments(), _dataStore.getBaseStats(), _corrGeneVector);
     }
     if (!_isSingleCell && _sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::DIFF) {
         qDebug() << "Compute filtering: 3D + ST + Diff";
-        _corrFilter.getDiffFilter().computeDiff(_subsetData3D, _dataStore.getBaseData(), _corrGeneVector);
+        updateFloodMoments(DataMatrix(), FloodMoments::noPositions);
+        _corrFilter.getDiffFilter().computeDiff(_computeSubset.getFloodMoments(), _dataStore.getBaseStats(), _corrGeneVector);
+    }
+    // -------------- Wilcoxon --------------
+    if (!_isSingleCell && _corrFilter.getFilterType() == corrFilter::CorrFilterType::WILCOXON) {
+        qDebug() << "Compute filtering: ST + Wilcoxon";
+        // the ranks of all points are computed once per dataset in the background, the selection is scored once they are done
+        if (!_dataStore.hasBaseRanks())
+        {
+            startRanking();
+            return;
+        }
+        // a selection only sums the ranks of its points
+        _corrFilter.getDiffFilter().computeRankDiff(_dataStore.getBaseRanks(), _sortedFloodIndices, _corrGeneVector);
     }
-    if (_isSingleCell && _corrFilter.getFilterType() == corrFilter::CorrFilterType::DIFF) {
+    // SingleCell only has the mean expression per cluster, so the rank test falls back to the weighted diff
+    if (_isSingleCell && (_corrFilter.getFilterType() == corrFilter::CorrFilterType::DIFF || _corrFilter.getFilterType() == corrFilter::CorrFilterType::WILCOXON)) {
         qDebug() << "Compute filtering: SingleCell +Diff";
         //_corrFilter.getDiffFilter().computeDiff(_subsetDataAvgOri, _avgExpr, _corrGeneVector); //without weighting
         
@@ -949,7 +1188,9 @@ void GeneSurferPlugin::updateSelection()
     // TODO temporary code only for 2D data and is very slow 
     if (!_isSingleCell && !_sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN) {
         qDebug() << "Compute filtering: 2D + ST + Moran";
-        _corrFilter.getMoranFilter().computeMoranVector(_sortedFloodIndices, _subsetData, _positions, _corrGeneVector);
+        DataMatrix floodData;
+        computeBaseSubsetData(_sortedFloodIndices, floodData);
+        _corrFilter.getMoranFilter().computeMoranVector(_sortedFloodIndices, floodData, _positions, _corrGeneVector);
     }
     if (!_isSingleCell && _sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN)
     {
@@ -960,7 +1201,9 @@ void GeneSurferPlugin::updateSelection()
         _positionDataset->extractDataForDimension(yPositions, 1);
         std::vector<float> zPositions;
         _positionDataset->extractDataForDimension(zPositions, 0);
-        _corrFilter.getMoranFilter().computeMoranVector(_sortedFloodIndices, _subsetData3D, xPositions, yPositions, zPositions, _corrGeneVector);
+        DataMatrix floodData;
+        computeBaseSubsetData(_sortedFloodIndices, floodData);
+        _corrFilter.getMoranFilter().computeMoranVector(_sortedFloodIndices, floodData, xPositions, yPositions, zPositions, _corrGeneVector);
     }
     if (_isSingleCell && !_sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::MORAN)
     {
@@ -991,9 +1234,9 @@ void GeneSurferPlugin::updateSelection()
     }
     if (!_isSingleCell && _sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::SPATIALZ) {
         qDebug() << "Compute filtering: 3D + ST + SpatialZ";
-        std::vector<float> zPositions;
-        _positionDataset->extractDataForDimension(zPositions, 0);
-        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_sortedFloodIndices, _subsetData3D, zPositions, _corrGeneVector);
+        // the moments keep the cross products with all axes, so switching between Y and Z reads no data
+        updateFloodMoments(getSpatialAxes(), 0);
+        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_computeSubset.getFloodMoments(), 0, _corrGeneVector);
     }
     if (_isSingleCell && _sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::SPATIALZ) {
         qDebug() << "Compute filtering: 3D + SingleCell + SpatialCorrZ";
@@ -1007,16 +1250,13 @@ void GeneSurferPlugin::updateSelection()
     // -------------- Spatial y --------------
     if (!_isSingleCell && !_sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::SPATIALY) {
         qDebug() << "Compute filtering: 2D + ST + SpatialCorrY";
-        std::vector<float> yPositions;
-        _positionDataset->extractDataForDimension(yPositions, 1);
-        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_sortedFloodIndices, _subsetData, yPositions, _corrGeneVector);
+        updateFloodMoments(getSpatialAxes(), 0);
+        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_computeSubset.getFloodMoments(), 1, _corrGeneVector);
     }
     if (!_isSingleCell && _sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::SPATIALY) {
         qDebug() << "Compute filtering: 3D + ST + SpatialCorrY";
-
-        std::vector<float> yPositions;
-        _positionDataset->extractDataForDimension(yPositions, 1);
-        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_sortedFloodIndices, _subsetData3D, yPositions, _corrGeneVector);
+        updateFloodMoments(getSpatialAxes(), 0);
+        _corrFilter.getSpatialCorrFilter().computeCorrelationVectorOneDimension(_computeSubset.getFloodMoments(), 1, _corrGeneVector);
     }
     if (_isSingleCell && !_sliceDataset.isValid() && _corrFilter.getFilterType() == corrFilter::CorrFilterType::SPATIALY) {
         qDebug() << "Compute filtering: 2D + SingleCell + SpatialCorrY";
@@ -1063,18 +1303,64 @@ void GeneSurferPlugin::updateSelection()
     //qDebug() << "GeneSurferPlugin::updateSelection(): end... ";
 }
 
+void GeneSurferPlugin::computeBaseSubsetData(const std::vector<int>& indices, DataMatrix& subsetData)
+{
+    if (_dataStore.isSparse())
+        _computeSubset.computeSubsetData(_dataStore.getBaseSparseData(), _dataStore.getBaseSparseOffsets(), indices, subsetData);
+    else if (_dataStore.isQuantized())
+        _computeSubset.computeSubsetData(_dataStore.getBaseQuantizedData(), indices, subsetData);
+    else
+        _computeSubset.computeSubsetData(_dataStore.getBaseData(), indices, subsetData);
+}
+
+void GeneSurferPlugin::computeBaseSubsetData(const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetData)
+{
+    if (_dataStore.isSparse())
+        _computeSubset.computeSubsetData(_dataStore.getBaseSparseData(), _dataStore.getBaseSparseOffsets(), indices, dimIndices, subsetData);
+    else if (_dataStore.isQuantized())
+        _computeSubset.computeSubsetData(_dataStore.getBaseQuantizedData(), indices, dimIndices, subsetData);
+    else
+        _computeSubset.computeSubsetData(_dataStore.getBaseData(), indices, dimIndices, subsetData);
+}
+
+void GeneSurferPlugin::updateFloodMoments(const DataMatrix& positions, int positionKey)
+{
+    if (_dataStore.isSparse())
+        _computeSubset.updateFloodMoments(_dataStore.getBaseSparseData(), _dataStore.getBaseSparseOffsets(), _sortedFloodIndices, positions, positionKey);
+    else if (_dataStore.isQuantized())
+        _computeSubset.updateFloodMoments(_dataStore.getBaseQuantizedData(), _sortedFloodIndices, positions, positionKey);
+    else
+        _computeSubset.updateFloodMoments(_dataStore.getBaseData(), _sortedFloodIndices, positions, positionKey);
+}
+
+const DataMatrix& GeneSurferPlugin::getSpatialAxes()
+{
+    if (_spatialAxes.rows() == _numPoints && _spatialAxes.cols() == _positionDataset->getNumDimensions())
+        return _spatialAxes;
+
+    _spatialAxes.resize(_numPoints, _positionDataset->getNumDimensions());
+
+    std::vector<float> positions;
+    for (int d = 0; d < _spatialAxes.cols(); ++d) {
+        _positionDataset->extractDataForDimension(positions, d);
+        _spatialAxes.col(d) = Eigen::Map<const Eigen::VectorXf>(positions.data(), _numPoints);
+    }
+
+    // centered, so the cross moments of the flood do not lose precision to the offset of the coordinates
+    _spatialAxes.rowwise() -= _spatialAxes.colwise().mean();
+
+    return _spatialAxes;
+}
+
 DataMatrix GeneSurferPlugin::populateAvgExprToSpatial() {
     // populate the data in subset for singlecell option
-    DataMatrix populatedSubsetAvg(_sortedFloodIndices.size(), _geneNamesAvgExpr.size());
-
-#pragma omp parallel for
+    // cluster row of every flooded cell, then one column-wise gather
+    std::vector<int> clusterRows(_sortedFloodIndices.size());
     for (int i = 0; i < _sortedFloodIndices.size(); ++i)
-    {
-        int index = _sortedFloodIndices[i];
-        QString label = _cellLabels[index];
-        auto row = _avgExpr(_clusterAliasToRowMap[label], Eigen::all);
-        populatedSubsetAvg.row(i) = row;
-    }
+        clusterRows[i] = _clusterAliasToRowMap[_cellLabels[_sortedFloodIndices[i]]];
+
+    DataMatrix populatedSubsetAvg;
+    gatherDenseRows(_avgExpr, clusterRows, populatedSubsetAvg);
 
     qDebug() << "populatedSubsetAvg size: " << populatedSubsetAvg.rows() << " " << populatedSubsetAvg.cols();
 
@@ -1082,18 +1368,13 @@ DataMatrix GeneSurferPlugin::populateAvgExprToSpatial() {
 }
 
 void GeneSurferPlugin::computeMeanWaveNumbersByCluster(std::vector<float>& waveAvg) {
-    std::unordered_map<QString, int> clusterWaveNumberSums;
-
-    for (int index = 0; index < _sortedFloodIndices.size(); ++index) {
-        int ptIndex = _sortedFloodIndices[index];
-        QString label = _cellLabels[ptIndex];
-        clusterWaveNumberSums[label] += _sortedWaveNumbers[index]; // for computing the average wave number
-    }
+    // the label counts per wave are computed once per flood-fill, labels are rows of _avgExpr
+    _computeSubset.updateWaveLabelCounts(_sortedFloodIndices, _sortedWaveNumbers, _cellLabelRows, _avgExpr.rows());
+    Eigen::VectorXf meanWaveNumbers = _computeSubset.getWaveAggregates().meanWaveNumberPerLabel();
 
     for (int i = 0; i < _clustersToKeep.size(); ++i) {
-        QString label = _clustersToKeep[i];
-        int count = _countsMap[label];
-        float average = (count > 0) ? static_cast<float>(clusterWaveNumberSums[label]) / count : 0.0f;
+        auto it = _clusterAliasToRowMap.find(_clustersToKeep[i]);
+        float average = (it != _clusterAliasToRowMap.end() && it->second < meanWaveNumbers.size()) ? meanWaveNumbers[it->second] : 0.0f;
         waveAvg.push_back(average);
     }
 
@@ -1312,9 +1593,15 @@ void GeneSurferPlugin::updateScatterPointSize()
     _dimView->setSourcePointSize(_settingsAction.getPointPlotAction().getPointSizeAction().getValue());
 }
 
+void GeneSurferPlugin::updateStatusLabel(const QString& status)
+{
+    _statusLabel->setText(status);
+    _statusLabel->setVisible(!status.isEmpty());
+}
+
 void GeneSurferPlugin::updateFilterLabel()
 {
-    _filterLabel->setText("Filter genes by:" + _corrFilter.getCorrFilterTypeAsString());
+    _filterLabel->setText("Filter genes by:" + _corrFilter.getCorrFilterTypeAsString() + (_rankWatcher.isRunning() ? " (ranking genes ...)" : ""));
 }
 
 
@@ -1397,18 +1684,21 @@ void GeneSurferPlugin::updateScatterColors()
                 break;
             }
 
-            std::vector<float> viewScalars(_onSliceIndices.size());
+            const std::vector<float>& clusterScalars = _colorScalars[j];
+            std::vector<float> viewScalars(_onSliceIndices.size(), 0.0f);
+
+            // the slice indices are sorted, so the last one is the only one that needs a range check
+            if (_onSliceIndices.empty() || _onSliceIndices.back() < clusterScalars.size()) {
 #pragma omp parallel for
-            for (int i = 0; i < _onSliceIndices.size(); i++)
-            {
-                if (_onSliceIndices[i] < _colorScalars[j].size()) {
-                    viewScalars[i] = _colorScalars[j][_onSliceIndices[i]];
-                }
-                else {
-                    qDebug() << "Column index out of range: j=" << j << " i=" << i << " _onSliceIndices[i]=" << _onSliceIndices[i];
-                    //break; // TO DO: remove this break statement
-                }
+                for (int i = 0; i < _onSliceIndices.size(); i++)
+                    viewScalars[i] = clusterScalars[_onSliceIndices[i]];
+            }
+            else {
+                qDebug() << "Column index out of range: j=" << j << " _onSliceIndices.back()=" << _onSliceIndices.back();
+                for (int i = 0; i < _onSliceIndices.size() && _onSliceIndices[i] < clusterScalars.size(); i++)
+                    viewScalars[i] = clusterScalars[_onSliceIndices[i]];
             }
+
             //_scatterViews[j]->setScalars(viewScalars, selection[0]); // TODO: check if this is needed
             _scatterViews[j]->setScalars(viewScalars, 1);
         }
@@ -1679,6 +1969,8 @@ void GeneSurferPlugin::loadLabelsFromSTDatasetFromFile() {
     // precompute the cell-label array
     _cellLabels.clear();
     _cellLabels.resize(_numPoints);
+    _cellLabelRows.assign(_numPoints, -1);
+    _computeSubset.invalidateWaveLabelCounts();
 
     int numClustersNotInST = 0;
 
@@ -1694,6 +1986,7 @@ void GeneSurferPlugin::loadLabelsFromSTDatasetFromFile() {
                 for (int j = 0; j < ptIndices.size(); ++j) {
                     int ptIndex = ptIndices[j];
                     _cellLabels[ptIndex] = clusterName;
+                    _cellLabelRows[ptIndex] = i;
                 }
                 // add weighting for each cluster of whole data
                 _countsAll[i] = ptIndices.size(); // number of pt in each cluster
@@ -1795,26 +2088,23 @@ void GeneSurferPlugin::clusterGenes()
 {
     //qDebug() << "clusterGenes start...";
 
+    // cleared until the new clusters are known, so the chart and the enrichment never read stale genes
+    _filteredGeneIndices.clear();
+    _filteredGeneLabels.clear();
+
     // filter genes based on the defined number of genes
     if (_numGenesThreshold > _enabledDimNames.size()) {
         qDebug() << "ERROR! clusterGenes(): _numGenesThreshold is larger than the number of genes";
         return;
     }
 
-    // create a vector of pairs (absolute correlation value, index)
-    std::vector<std::pair<float, int>> pairs(_corrGeneVector.size());
-    for (int i = 0; i < _corrGeneVector.size(); ++i) {
-        pairs[i] = std::make_pair(std::abs(_corrGeneVector[i]), i);
-    }
-
-    // partially sort to find the top _numGenesThreshold elements
-    std::nth_element(pairs.begin(), pairs.begin() + _numGenesThreshold, pairs.end(), std::greater<>());
+    // the top _numGenesThreshold genes by absolute correlation, without sorting all genes
+    std::vector<int> filteredDimIndices = selectTopAbsoluteGenes(_corrGeneVector, _numGenesThreshold); //indices in _enabledDimNames TO DO: might not work with modified _enabledDimNames
 
     std::vector<QString> filteredDimNames;
-    std::vector<int> filteredDimIndices;
-    for (int i = 0; i < _numGenesThreshold; ++i) {
-        filteredDimNames.push_back(_enabledDimNames[pairs[i].second]);
-        filteredDimIndices.push_back(pairs[i].second); //indices in _enabledDimNames TO DO: might not work with modified _enabledDimNames
+    filteredDimNames.reserve(filteredDimIndices.size());
+    for (int dimIndex : filteredDimIndices) {
+        filteredDimNames.push_back(_enabledDimNames[dimIndex]);
     }
      
     //qDebug() << "GeneSurferPlugin::clusterGenes(): filteredDimNames size: " << filteredDimNames.size();
@@ -1835,6 +2125,14 @@ void GeneSurferPlugin::clusterGenes()
         _toClearBarchart = false;
     }
 
+    // columns of the filtered genes in _subsetData/_subsetData3D
+    // ST: only the flooded rows of the filtered genes are gathered, SC: the subset holds all genes
+    std::vector<int> subsetDimIndices = filteredDimIndices;
+    if (!_isSingleCell) {
+        computeBaseSubsetData(_sortedFloodIndices, filteredDimIndices, _sliceDataset.isValid() ? _subsetData3D : _subsetData);
+        std::iota(subsetDimIndices.begin(), subsetDimIndices.end(), 0);
+    }
+
     // compute the correlation between each pair of the filtered genes
     //auto start2 = std::chrono::high_resolution_clock::now();
 
@@ -1843,18 +2141,24 @@ void GeneSurferPlugin::clusterGenes()
 
     if (!_sliceDataset.isValid()) {
         //qDebug() << "computePairwiseCorrelationVector: 2D dataset";
-        if (!_isSingleCell) {
-            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, filteredDimIndices, _subsetData, corrFilteredGene);// TO DO: dimNames not needed in this function
+        if (!_isSingleCell && _dataStore.isSparse()) {
+            _corrFilter.computePairwiseCorrelationVector(filteredDimIndices, _dataStore.getBaseSparseData(), _sortedFloodIndices, corrFilteredGene);
+        }
+        else if (!_isSingleCell) {
+            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, subsetDimIndices, _subsetData, corrFilteredGene);// TO DO: dimNames not needed in this function
         }
         else {
             // add weighting 
-            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, filteredDimIndices, _subsetData, _countsSubset, corrFilteredGene);// SC: with weighting
+            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, subsetDimIndices, _subsetData, _countsSubset, corrFilteredGene);// SC: with weighting
         }
     } 
     else {
         //qDebug() << "computePairwiseCorrelationVector: 3D dataset";
-        if (!_isSingleCell) {
-           _corrFilter.computePairwiseCorrelationVector(filteredDimNames, filteredDimIndices, _subsetData3D, corrFilteredGene);// ST: without weighting
+        if (!_isSingleCell && _dataStore.isSparse()) {
+            _corrFilter.computePairwiseCorrelationVector(filteredDimIndices, _dataStore.getBaseSparseData(), _sortedFloodIndices, corrFilteredGene);// ST: without weighting
+        }
+        else if (!_isSingleCell) {
+           _corrFilter.computePairwiseCorrelationVector(filteredDimNames, subsetDimIndices, _subsetData3D, corrFilteredGene);// ST: without weighting
         }
         else {
             // add weighting 
@@ -1863,7 +2167,7 @@ void GeneSurferPlugin::clusterGenes()
             qDebug() << "computePairwiseCorrelationVector: _countsSubset size: " << _countsSubset.size() << "_countsSubset[0] " << _countsSubset[0];
             qDebug() << "computePairwiseCorrelationVector: filteredDimNames size: " << filteredDimNames.size() << " filteredDimIndices size: " << filteredDimIndices.size();*/
 
-            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, filteredDimIndices, _subsetData3D, _countsSubset, corrFilteredGene);// SC: with weighting
+            _corrFilter.computePairwiseCorrelationVector(filteredDimNames, subsetDimIndices, _subsetData3D, _countsSubset, corrFilteredGene);// SC: with weighting
 
             // output the element in the first row and first column of corrFilteredGene
             /*qDebug() << "GeneSurferPlugin::clusterGenes(): corrFilteredGene(0,0): " << corrFilteredGene(0, 0);
@@ -1950,11 +2254,9 @@ void GeneSurferPlugin::clusterGenes()
     // inspect dendrogram ----------------------------------------end
 
 
-    // Mapping labels back to dimension names
-    _dimNameToClusterLabel.clear();
-    for (int i = 0; i < n; ++i) {
-        _dimNameToClusterLabel[filteredDimNames[i]] = labels[i];
-    }
+    // Mapping labels back to the filtered genes
+    _filteredGeneIndices = filteredDimIndices;
+    _filteredGeneLabels.assign(labels, labels + n);
 
     /*auto end3 = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> elapsed3 = end3 - start3;
@@ -1976,7 +2278,7 @@ void GeneSurferPlugin::clusterGenes()
     if (_isSingleCell != true) {
         //auto start5 = std::chrono::high_resolution_clock::now();
 
-        computeFloodedClusterScalars(filteredDimIndices, labels);
+        computeFloodedClusterScalars(subsetDimIndices, labels);
 
         /*auto end5 = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double, std::milli> elapsed5 = end5 - start5;
@@ -2025,14 +2327,30 @@ void GeneSurferPlugin::computeEntireClusterScalars(const std::vector<int> filter
     std::cout << "1 old Elapsed time: " << elapsed1.count() << " ms\n";*/
 
     auto start11 = std::chrono::high_resolution_clock::now();
-    Eigen::MatrixXf allMeans = Eigen::MatrixXf::Zero(_nclust, _dataStore.getBaseData().rows());
+    Eigen::MatrixXf allMeans = Eigen::MatrixXf::Zero(_nclust, _dataStore.getNumBasePoints());
     std::vector<int> dimensionsPerCluster(_nclust, 0);
 
+    const bool isSparse = _dataStore.isSparse();
+    const bool isQuantized = _dataStore.isQuantized();
+    const auto& sparseData = _dataStore.getBaseSparseData();
+    const auto& sparseOffsets = _dataStore.getBaseSparseOffsets();
+    const auto& quantizedData = _dataStore.getBaseQuantizedData();
+
     #pragma omp parallel for  
     for (int cluster = 0; cluster < _nclust; ++cluster) {
+        Eigen::VectorXf decodedColumn(isQuantized ? quantizedData.rows() : 0);
         for (int d = 0; d < filteredDimIndices.size(); ++d) {
             if (labels[d] == cluster) {
-                allMeans.row(cluster) += baseData.col(filteredDimIndices[d]);
+                if (isSparse) {
+                    allMeans.row(cluster) += sparseData.col(filteredDimIndices[d]).transpose();
+                    allMeans.row(cluster).array() -= sparseOffsets[filteredDimIndices[d]];
+                }
+                else if (isQuantized) {
+                    quantizedData.decodeColumn(filteredDimIndices[d], decodedColumn.data());
+                    allMeans.row(cluster) += decodedColumn.transpose();
+                }
+                else
+                    allMeans.row(cluster) += baseData.col(filteredDimIndices[d]);
                 dimensionsPerCluster[cluster]++;
             }
         }
@@ -2100,16 +2418,8 @@ void GeneSurferPlugin::computeFloodedClusterScalars(const std::vector<int> filte
     _colorScalars.clear();
     _colorScalars.resize(_nclust, std::vector<float>(_numPoints, 0.0f));
 
-    DataMatrix subsetData;
-    
-    if (!_sliceDataset.isValid()) {
-        // 2D dataset
-        subsetData = _subsetData;
-    }
-    else {
-        // 3D dataset
-        subsetData = _subsetData3D;
-    }
+    // 2D or 3D dataset, the columns are the filtered genes, see clusterGenes()
+    const DataMatrix& subsetData = _sliceDataset.isValid() ? _subsetData3D : _subsetData;
 
     Eigen::MatrixXf subsetMeans = Eigen::MatrixXf::Zero(_nclust, subsetData.rows());
     std::vector<int> dimensionsPerCluster(_nclust, 0);
@@ -2215,9 +2525,10 @@ void GeneSurferPlugin::getFuntionalEnrichment()
 {
     QStringList geneNamesInCluster;
     _simplifiedToIndexGeneMapping.clear();
-    for (const auto& pair : _dimNameToClusterLabel) {
-        if (pair.second == _selectedClusterIndex) {
-            QString geneName = pair.first;
+    // the genes of the cluster in the order of their absolute correlation, see selectTopAbsoluteGenes() in clusterGenes()
+    for (size_t i = 0; i < _filteredGeneIndices.size(); ++i) {
+        if (_filteredGeneLabels[i] == _selectedClusterIndex) {
+            QString geneName = _enabledDimNames[_filteredGeneIndices[i]];
             QString simplifiedGeneName = geneName;// copy for potential modification
 
             // check if gene name contains an _copy index - for modified duplicate gene symbols in ABC Atlas
@@ -2504,26 +2815,33 @@ void GeneSurferPlugin::updateSlice(int sliceIndex) {
 
     QString clusterName = _sliceDataset->getClusters()[_currentSliceIndex].getName();
 
-    std::vector<uint32_t>& uindices = _sliceDataset->getClusters()[_currentSliceIndex].getIndices();
-    std::vector<int> indices;
-    indices.assign(uindices.begin(), uindices.end());
+    // built once per slice dataset, switching slices only copies the sorted indices of the slice
+    const int numSlices = _sliceDataset->getClusters().size();
+    if (!_sliceIndex.isBuilt(_numPoints, numSlices))
+        _sliceIndex.build(_numPoints, numSlices, [this](int slice) -> const std::vector<uint32_t>& { return _sliceDataset->getClusters()[slice].getIndices(); });
+
+    std::span<const int> sliceIndices = _sliceIndex.getSliceIndices(_currentSliceIndex);
 
-    _onSliceIndices.clear();
-    _onSliceIndices = indices;
+    // assign() keeps the capacity of the previous slice
+    _onSliceIndices.assign(sliceIndices.begin(), sliceIndices.end());
+    _onSliceMask.assign(_numPoints, _onSliceIndices);
     
-    _dataStore.createDataView(indices);
-    updateSelectedDim();
+    // the view is rebuilt once a background load finished
+    if (_dataInitialized) {
+        _dataStore.createDataView(_onSliceIndices);
+        updateSelectedDim();
+    }
 
     // update floodfill mask on 2D
     if (_isFloodIndex.empty()) {
         qDebug() << "GeneSurferPlugin::updateSlice(): _isFloodIndex is empty";
     }
     else {
-        _isFloodOnSlice.clear(); // TO DO: repeated code with updateFloodFill()
-        _isFloodOnSlice.resize(_onSliceIndices.size(), false);
-        for (int i = 0; i < _onSliceIndices.size(); i++)
-        {
-            _isFloodOnSlice[i] = _isFloodIndex[_onSliceIndices[i]];
+        // only the flooded points are looked up, instead of testing every point of the slice
+        _isFloodOnSlice.resize(_onSliceIndices.size());
+        for (int index : _sortedFloodIndices) {
+            if (index < _sliceIndex.getNumPoints() && _sliceIndex.getSlice(index) == _currentSliceIndex)
+                _isFloodOnSlice.set(_sliceIndex.getLocalIndex(index));
         }
     }    
 
@@ -2606,7 +2924,7 @@ void GeneSurferPlugin::fromVariantMap(const QVariantMap& variantMap)
         if (!_sliceDataset.isValid())
            _computeSubset.updateSelectedData(_positionDataset, selection, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex);
         else
-          _computeSubset.updateSelectedData(_positionDataset, selection, _onSliceIndices, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
+          _computeSubset.updateSelectedData(_positionDataset, selection, _onSliceIndices, _onSliceMask, _sortedFloodIndices, _sortedWaveNumbers, _isFloodIndex, _isFloodOnSlice, _onSliceFloodIndices);
         updateSelection();
     }
 
@@ -7,6 +7,8 @@
 #include "Compute/EnrichmentAnalysis.h"
 #include "Compute/CorrFilter.h"
 #include "Compute/DataSubset.h"
+#include "Compute/PointSelection.h"
+#include "Compute/SliceIndex.h"
 
 #include "Actions/SettingsAction.h"
 #include "TableWidget.h"
@@ -27,6 +29,9 @@
 #include <QTableWidgetItem>
 
 #include <QFileDialog>
+#include <QFutureWatcher>
+
+#include <memory>
 
 using namespace mv;
 
@@ -61,7 +66,7 @@ public:
     GeneSurferPlugin(const PluginFactory* factory);
 
     /** Destructor */
-    ~GeneSurferPlugin() override = default;
+    ~GeneSurferPlugin() override { cancelRanking(); cancelIngestion(); }
     
     /** This function is called by the core after the view plugin has been created */
     void init() override;
@@ -103,6 +108,9 @@ public:
     void updateSelection();
 
     void updateFilterLabel();//TODO: connect with filter type change
+
+    /** Show \p status below the filter label, an empty status hides it */
+    void updateStatusLabel(const QString& status);
     
 public slots:
     /** Converts ManiVault's point data to a json-like data structure that Qt can pass to the JS code */
@@ -133,6 +141,21 @@ private:
     /** Update the _dimView */
     void updateDimView(const QString& selectedDim);
 
+    /** Apply the storage settings of the storage action to \p dataStore */
+    void applyStorageSettings(DataStorage& dataStore);
+
+    /** Gather the rows \p indices of the base data into \p subsetData, for any storage of _dataStore */
+    void computeBaseSubsetData(const std::vector<int>& indices, DataMatrix& subsetData);
+
+    /** Gather the rows \p indices of only the columns \p dimIndices of the base data into \p subsetData */
+    void computeBaseSubsetData(const std::vector<int>& indices, const std::vector<int>& dimIndices, DataMatrix& subsetData);
+
+    /** Update the running moments of _sortedFloodIndices for any storage of _dataStore, see DataSubset::updateFloodMoments() */
+    void updateFloodMoments(const DataMatrix& positions, int positionKey);
+
+    /** Positions of all points with one column per dimension of _positionDataset, centered on their mean, extracted once per dataset */
+    const DataMatrix& getSpatialAxes();
+
     /** Cluster genes based on their pairwise correlations */
     void clusterGenes();
 
@@ -183,6 +206,11 @@ private:
 private:
 
     DataStorage                        _dataStore;
+    std::shared_ptr<DataStorage>       _stagedDataStore;         // Filled by the background ingestion, moved into _dataStore when it finished
+    QFutureWatcher<bool>               _ingestWatcher;           // Background ingestion, its result is false if it was cancelled
+    bool                               _storageChangePending = false; // A re-ingestion for changed storage settings is scheduled
+    std::shared_ptr<GeneRanks>         _pendingRanks;            // Filled by the background ranking of _dataStore, moved into it when it finished
+    QFutureWatcher<bool>               _rankWatcher;             // Background ranking, its result is false if it was cancelled
 
     ChartWidget*                       _chartWidget;             // WebWidget that sets up the HTML page - bar chart
     MyTableWidget*                     _tableWidget;             // Customized table widget for enrichment analysis
@@ -192,16 +220,17 @@ private:
     Dataset<Points>                    _positionDataset;         // Smart pointer to points dataset for point position
     Dataset<Points>                    _positionSourceDataset;   // Smart pointer to source of the points dataset for point position (if any)
     std::vector<Vector2f>              _positions;               // Point positions - if 3D, _positions is the 2D projection of the 3D data
+    DataMatrix                         _spatialAxes;             // Centered point positions of all dimensions, see getSpatialAxes()
     int32_t                            _numPoints;               // Number of point positions
     std::vector<QString>               _enabledDimNames;
     bool                               _dataInitialized = false;
 
     // FloodFill subset computing
-    std::vector<bool>                  _isFloodIndex;            // Direct mapping for flood indices
+    PointSelection                     _isFloodIndex;            // Direct mapping for flood indices
     Dataset<Points>                    _floodFillDataset;        // Dataset for flood fill
     std::vector<int>                   _sortedFloodIndices;      // Spatially sorted indices of flood fill at the current cursor position
     std::vector<int>                   _sortedWaveNumbers;       // Spatially sorted wave numbers of flood fill at the current cursor position
-    Eigen::MatrixXf                    _subsetData;              // Subset of flooded data, sorted spatially
+    Eigen::MatrixXf                    _subsetData;              // Subset of flooded data, sorted spatially; ST: only the filtered genes, see clusterGenes()
     DataSubset                         _computeSubset;             // Flood subset computing
 
     // Filtering genes based on correlation
@@ -209,10 +238,12 @@ private:
     int                                _numGenesThreshold = 50;
     corrFilter::CorrFilter             _corrFilter;
     QLabel*                            _filterLabel;             // Label for filtering genes on the bar chart
+    QLabel*                            _statusLabel;             // Label for the progress of loading the data on the bar chart
 
     // Clustering
     int                                _nclust;                  // Number of clusters
-    std::unordered_map<QString, int>   _dimNameToClusterLabel;   // Map dimension name to cluster label
+    std::vector<int>                   _filteredGeneIndices;     // Indices in _enabledDimNames of the clustered genes, by descending absolute correlation
+    std::vector<int>                   _filteredGeneLabels;      // Cluster label of each gene in _filteredGeneIndices
     std::map<int, int>                 _numGenesInCluster;        // Number of genes in each gene-set cluster
 
     // Interaction
@@ -225,11 +256,13 @@ private:
     // 3D data
     int                                _currentSliceIndex = 0;   // Current slice index for 3D slice dataset
     Dataset<Clusters>                  _sliceDataset;            // Dataset for 3D slices
+    SliceIndex                         _sliceIndex;              // Points of all slices of _sliceDataset, built on the first updateSlice()
     std::vector<int>                   _onSliceIndices;          // Pt indices on the current slice
+    PointSelection                     _onSliceMask;             // Pt indices on the current slice as bitmap over all points
     std::vector<int>                   _onSliceFloodIndices;     // Flood indices on the slice
     std::vector<int>                   _onSliceWaveNumbers;      // Wave numbers on the slice
-    std::vector<bool>                  _isFloodOnSlice;          // Direct mapping for flood indices on the slice
-    Eigen::MatrixXf                    _subsetData3D;            // Subset of flooded data 3D
+    PointSelection                     _isFloodOnSlice;          // Direct mapping for flood indices on the slice
+    Eigen::MatrixXf                    _subsetData3D;            // Subset of flooded data 3D; ST: only the filtered genes, see clusterGenes()
 
     // Enrichment Analysis
     EnrichmentAnalysis*                _client;                  // Enrichment analysis client 
@@ -247,6 +280,7 @@ private:
     std::vector<QString>               _clusterNamesAvgExpr;     // From avg expr single cell data
     std::unordered_map<QString, int>   _clusterAliasToRowMap;    // Map label (QString) to row index in _avgExpr
     std::vector<QString>               _cellLabels;              // Labels for each point
+    std::vector<int>                   _cellLabelRows;           // Row in _avgExpr of the label of each point, -1 if unlabeled
     std::unordered_map<QString, int>   _countsMap;               // Count distribution of labels WITHIN floodfill
     std::vector<QString>               _clustersToKeep;          // clusters to keep for avg expression - same order as subset row - cluster alias name 
     Eigen::VectorXf                    _countsSubset;            // counts for each label within the subset - same order as subset row
@@ -266,9 +300,33 @@ public:
     bool isUsingSingleCell() { return _isSingleCell; }
 
 public: // Data loading
-    /** Invoked when the position points dataset changes */
+    /** Invoked when the position points dataset changes, starts the ingestion of its data in the background */
     void positionDatasetChanged();
 
+    /**
+     * Ingest the position dataset into a new storage in the background, aborting a running ingestion
+     * The data is copied from the datasets first, on the GUI thread; \p useCache false ignores the disk cache setting
+     */
+    void startIngestion(bool useCache = true);
+
+    /** Invoked when the background ingestion finished, makes the new data current unless it was cancelled */
+    void finishIngestion();
+
+    /** Abort a running background ingestion and wait for it to stop */
+    void cancelIngestion();
+
+    /** Invoked when the storage mode changes, re-ingests the current data into the new storage in the background */
+    void updateStorageMode();
+
+    /** Rank the current data in the background for the rank-sum filter, unless a ranking is running already */
+    void startRanking();
+
+    /** Invoked when the background ranking finished, keeps the ranks and scores the selection unless it was cancelled */
+    void finishRanking();
+
+    /** Abort a running background ranking and wait for it to stop */
+    void cancelRanking();
+
 public:
     /** Get smart pointer to points dataset for point position */
     Dataset<Points>& getPositionDataset() { return _positionDataset; }